@@ -3,6 +3,8 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
 /* A block device. */
@@ -28,6 +30,8 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void transfer (struct block *, block_sector_t, size_t cnt,
+                      void *buffer, bool write);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -113,6 +117,19 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Verifies that the CNT sectors starting at SECTOR lie within
+   BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector, size_t cnt)
+{
+  ASSERT (cnt > 0);
+  check_sector (block, sector);
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", cnt=%zu, "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt,
+           block->size);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +137,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  transfer (block, sector, 1, buffer, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +148,122 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  transfer (block, sector, 1, (void *) buffer, true);
+}
+
+/* Reads the CNT consecutive sectors starting at SECTOR from
+   BLOCK into BUFFER, which must have room for CNT *
+   BLOCK_SECTOR_SIZE bytes.  Devices that can do so transfer all
+   of them in one request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     size_t cnt, void *buffer)
+{
+  transfer (block, sector, cnt, buffer, false);
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving the
+   data.  Devices that can do so transfer all of them in one
+   request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      size_t cnt, const void *buffer)
+{
+  transfer (block, sector, cnt, (void *) buffer, true);
+}
+
+/* Initializes REQ to transfer the CNT sectors starting at SECTOR
+   between a block device and BUFFER, writing to the device if
+   WRITE is true and reading from it otherwise.  If DONE is
+   non-null, it is called with REQ on completion; otherwise,
+   block_wait() waits for completion. */
+void
+block_request_init (struct block_request *req, block_sector_t sector,
+                    size_t cnt, void *buffer, bool write,
+                    block_done_func *done, void *aux)
+{
+  req->sector = sector;
+  req->cnt = cnt;
+  req->buffer = buffer;
+  req->write = write;
+  req->done = done;
+  req->aux = aux;
+  sema_init (&req->completed, 0);
+  req->driver_data = NULL;
+  req->submit_time = 0;
+}
+
+/* Starts carrying out REQ on BLOCK and returns.  Depending on
+   the driver, REQ may complete before or after this function
+   returns.  Requests to the same device may complete in any
+   order.  Must not be called from an interrupt handler. */
+void
+block_submit (struct block *block, struct block_request *req)
+{
+  ASSERT (!intr_context ());
+
+  check_sectors (block, req->sector, req->cnt);
+  if (req->write)
+    {
+      ASSERT (block->type != BLOCK_FOREIGN);
+      block->write_cnt += req->cnt;
+    }
+  else
+    block->read_cnt += req->cnt;
+  req->submit_time = timer_read_tsc ();
+
+  if (block->ops->submit != NULL)
+    block->ops->submit (block->aux, req);
+  else
+    {
+      if (req->write && block->ops->write_multiple != NULL)
+        block->ops->write_multiple (block->aux, req->sector, req->cnt,
+                                    req->buffer);
+      else if (!req->write && block->ops->read_multiple != NULL)
+        block->ops->read_multiple (block->aux, req->sector, req->cnt,
+                                   req->buffer);
+      else
+        {
+          uint8_t *p = req->buffer;
+          size_t i;
+
+          for (i = 0; i < req->cnt; i++, p += BLOCK_SECTOR_SIZE)
+            if (req->write)
+              block->ops->write (block->aux, req->sector + i, p);
+            else
+              block->ops->read (block->aux, req->sector + i, p);
+        }
+      block_complete (req);
+    }
+}
+
+/* Waits for REQ, which must have no completion callback, to
+   complete. */
+void
+block_wait (struct block_request *req)
+{
+  ASSERT (req->done == NULL);
+  sema_down (&req->completed);
+}
+
+/* Transfers the CNT sectors starting at SECTOR between BLOCK and
+   BUFFER, in the direction given by WRITE, and waits for the
+   transfer to complete. */
+static void
+transfer (struct block *block, block_sector_t sector, size_t cnt,
+          void *buffer, bool write)
+{
+  struct block_request req;
+
+  block_request_init (&req, sector, cnt, buffer, write, NULL, NULL);
+  block_submit (block, &req);
+  block_wait (&req);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,7 +287,9 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Prints statistics for each block device used for a Pintos role,
+   followed by the CPU cost of IDE transfers and the IDE request
+   queues' behavior. */
 void
 block_print_stats (void)
 {
@@ -176,6 +305,7 @@ block_print_stats (void)
                   block->read_cnt, block->write_cnt);
         }
     }
+  ide_print_stats ();
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -211,6 +341,18 @@ block_register (const char *name, enum block_type type,
   return block;
 }
 
+/* Called by a driver when it is done with REQ.  Calls REQ's
+   completion callback or wakes up its waiter.  REQ may be freed
+   by then, so the driver must not touch it afterward. */
+void
+block_complete (struct block_request *req)
+{
+  if (req->done != NULL)
+    req->done (req);
+  else
+    sema_up (&req->completed);
+}
+
 /* Returns the block device corresponding to LIST_ELEM, or a null
    pointer if LIST_ELEM is the list end of all_blocks. */
 static struct block *
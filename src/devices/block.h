@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,9 +55,46 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt, void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous requests. */
+
+struct block_request;
+
+/* Called when a request completes.  Runs in the context of the
+   driver's dispatch thread, so it must not wait for other
+   requests to the same device. */
+typedef void block_done_func (struct block_request *);
+
+/* A request to transfer CNT consecutive sectors, submitted with
+   block_submit().  The submitter provides the storage and must
+   keep it, and BUFFER, intact until the request completes. */
+struct block_request
+  {
+    block_sector_t sector;              /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+    void *buffer;                       /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                         /* Write to device (else read)? */
+    block_done_func *done;              /* Completion callback, or null. */
+    void *aux;                          /* For use by DONE. */
+
+    /* Owned by the block layer and drivers. */
+    struct semaphore completed;         /* Up'd on completion if no DONE. */
+    struct list_elem elem;              /* Element in a driver queue. */
+    void *driver_data;                  /* For use by the driver. */
+    uint64_t submit_time;               /* TSC at submission. */
+  };
+
+void block_request_init (struct block_request *, block_sector_t,
+                         size_t cnt, void *buffer, bool write,
+                         block_done_func *, void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+
 /* Statistics. */
 void block_print_stats (void);
 
@@ -65,10 +104,26 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Transfer CNT consecutive sectors in a single request.
+       Optional: if null, the sectors are transferred one at a
+       time with READ or WRITE. */
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
+
+    /* Queues REQ and returns, possibly before it completes.  The
+       driver calls block_complete() once it is done.  Optional:
+       if null, requests are carried out synchronously with the
+       functions above.  A driver that provides SUBMIT need not
+       provide the others. */
+    void (*submit) (void *aux, struct block_request *req);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_complete (struct block_request *);
 
 #endif /* devices/block.h */
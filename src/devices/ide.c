@@ -9,9 +9,24 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   If the IDE controller is a PCI bus master, such as the PIIX
+   that QEMU and Bochs emulate, data is moved by DMA, which
+   leaves the CPU free while the disk works.  Otherwise, and if a
+   DMA transfer ever fails, the CPU moves the data itself with
+   programmed I/O (PIO).
+
+   Block requests are queued per channel and carried out, one at
+   a time, by a dispatch thread for that channel, so the two
+   channels work in parallel.  The dispatcher picks the next
+   request by C-LOOK: it serves requests in increasing sector
+   order and, once none is left ahead of the last one it served,
+   starts over from the lowest-numbered one. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -33,7 +48,9 @@
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
+#define STA_DF 0x20             /* Device Fault. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +66,55 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus master IDE port addresses, relative to the channel's bus
+   master base.  See [PIIX] section 2.7, "Bus Master IDE I/O
+   Registers". */
+#define bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)    /* Command. */
+#define bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)     /* Status. */
+#define bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)       /* PRD table address. */
+
+/* Bus master Command Register bits. */
+#define BMC_START 0x01          /* Start bus master transfer. */
+#define BMC_READ 0x08           /* Disk to memory (else memory to disk). */
+
+/* Bus master Status Register bits. */
+#define BMS_ERROR 0x02          /* Error (write 1 to clear). */
+#define BMS_INTR 0x04           /* Interrupt (write 1 to clear). */
+
+/* PCI configuration space, which we use only to find a bus
+   master IDE controller.  See [PCI] section 3.2.2.3.2. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Address port. */
+#define PCI_CONFIG_DATA 0xcfc   /* Data port. */
+#define PCI_ID 0x00             /* Vendor and device ID register. */
+#define PCI_COMMAND 0x04        /* Command register. */
+#define PCI_CLASS 0x08          /* Class code register. */
+#define PCI_BAR4 0x20           /* Base address register 4. */
+#define PCI_CMD_IO 0x0001       /* Enable I/O space. */
+#define PCI_CMD_MASTER 0x0004   /* Enable bus mastering. */
+
+/* A physical region descriptor, which describes one physically
+   contiguous piece of a DMA buffer to the bus master.  A piece
+   may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes, 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT in the last descriptor. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Maximum sectors per command, given the 8-bit sector count
+   register, and PRD descriptors per channel, enough for a buffer
+   that size crossing two 64 kB boundaries. */
+#define CMD_MAX_SECTORS 256
+#define PRD_CNT 4
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +123,8 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool use_dma;               /* Transfer data by DMA? */
+    int multiple_cnt;           /* Sectors per PIO interrupt. */
   };
 
 /* An ATA channel (aka controller).
@@ -66,6 +134,8 @@ struct channel
     char name[8];               /* Name, e.g. "ide0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus master base I/O port, 0 if none. */
+    struct prd *prdt;           /* PRD table for DMA. */
 
     struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
@@ -73,22 +143,64 @@ struct channel
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
+
+    /* Request queue. */
+    struct lock queue_lock;     /* Protects the members below. */
+    struct condition queue_nonempty;    /* Signaled when QUEUE grows. */
+    struct list queue;          /* Pending requests, ordered by key. */
+    uint32_t head;              /* Key just past the last request served. */
+    size_t depth;               /* Requests queued or in progress. */
+
+    /* Statistics. */
+    unsigned long long request_cnt;     /* Requests completed. */
+    unsigned long long depth_sum;       /* Sum of DEPTH seen by arrivals. */
+    size_t max_depth;                   /* Largest DEPTH seen. */
+    uint64_t wait_cycles;               /* Total time requests queued. */
+    uint64_t service_cycles;            /* Total time requests in service. */
   };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* PRD tables.  The bus master requires each to be 4-byte aligned
+   and not to cross a 64 kB boundary, which aligning each to its
+   own size ensures.  Kernel virtual and physical addresses share
+   the same alignment. */
+static struct prd prd_tables[CHANNEL_CNT][PRD_CNT]
+  __attribute__ ((aligned (PRD_CNT * sizeof (struct prd))));
+
+/* The CPU cost of the data transferred in one mode. */
+struct xfer_stats
+  {
+    unsigned long long sector_cnt;      /* Sectors transferred. */
+    uint64_t cycles;                    /* CPU cycles, excluding waits. */
+  };
+
+static struct xfer_stats pio_stats, dma_stats;
+
 static struct block_operations ide_operations;
 
+static thread_func dispatch_thread NO_RETURN;
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
+static bool set_multiple_mode (struct ata_disk *, int cnt);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static uint16_t find_bus_master (void);
+
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+static uint64_t wait_for_completion (struct channel *);
+
+static void pio_read (struct ata_disk *, block_sector_t, void *, size_t cnt);
+static void pio_write (struct ata_disk *, block_sector_t, const void *,
+                       size_t cnt);
+static bool dma_transfer (struct ata_disk *, block_sector_t, void *,
+                          size_t cnt, bool write);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -101,6 +213,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -123,9 +236,19 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
+      c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+      c->prdt = prd_tables[chan_no];
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      lock_init (&c->queue_lock);
+      cond_init (&c->queue_nonempty);
+      list_init (&c->queue);
+      c->head = 0;
+      c->depth = 0;
+      c->request_cnt = c->depth_sum = 0;
+      c->max_depth = 0;
+      c->wait_cycles = c->service_cycles = 0;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +259,8 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->use_dma = false;
+          d->multiple_cnt = 1;
         }
 
       /* Register interrupt handler. */
@@ -144,6 +269,10 @@ ide_init (void)
       /* Reset hardware. */
       reset_channel (c);
 
+      /* Start serving requests, which the partition scan when a
+         disk is registered will need. */
+      thread_create (c->name, PRI_MAX, dispatch_thread, c);
+
       /* Distinguish ATA hard disks from other devices. */
       if (check_device_type (&c->devices[0]))
         check_device_type (&c->devices[1]);
@@ -155,6 +284,46 @@ ide_init (void)
     }
 }
 
+/* Scans PCI bus 0 for an IDE controller that can act as a bus
+   master.  If one is found, enables its bus mastering and
+   returns the base of its bus master I/O ports, of which the
+   first 8 belong to the primary channel and the next 8 to the
+   secondary.  Returns 0 if there is no such controller. */
+static uint16_t
+find_bus_master (void) 
+{
+  int dev_no, func;
+
+  for (dev_no = 0; dev_no < 32; dev_no++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t addr = 0x80000000 | (dev_no << 11) | (func << 8);
+        uint32_t class, bar, command;
+
+        outl (PCI_CONFIG_ADDR, addr | PCI_ID);
+        if ((inl (PCI_CONFIG_DATA) & 0xffff) == 0xffff)
+          continue;
+
+        /* Mass storage, IDE, with bus master support. */
+        outl (PCI_CONFIG_ADDR, addr | PCI_CLASS);
+        class = inl (PCI_CONFIG_DATA);
+        if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+          continue;
+
+        /* Bus master registers must be in I/O space. */
+        outl (PCI_CONFIG_ADDR, addr | PCI_BAR4);
+        bar = inl (PCI_CONFIG_DATA);
+        if ((bar & 1) == 0 || (bar & 0xfffc) == 0)
+          continue;
+
+        outl (PCI_CONFIG_ADDR, addr | PCI_COMMAND);
+        command = inl (PCI_CONFIG_DATA) & 0xffff;
+        outl (PCI_CONFIG_DATA, command | PCI_CMD_IO | PCI_CMD_MASTER);
+        return bar & 0xfffc;
+      }
+  return 0;
+}
+
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
@@ -265,17 +434,22 @@ identify_ata_device (struct ata_disk *d)
   char *model, *serial;
   char extra_info[128];
   struct block *block;
+  int multiple_cnt;
 
   ASSERT (d->is_ata);
 
   /* Send the IDENTIFY DEVICE command, wait for an interrupt
      indicating the device's response is ready, and read the data
-     into our buffer. */
+     into our buffer.  The other disk on the channel may already
+     be registered, so its dispatcher could be using the
+     controller. */
+  lock_acquire (&c->lock);
   select_device_wait (d);
   issue_pio_command (c, CMD_IDENTIFY_DEVICE);
   sema_down (&c->completion_wait);
   if (!wait_while_busy (d))
     {
+      lock_release (&c->lock);
       d->is_ata = false;
       return;
     }
@@ -286,8 +460,20 @@ identify_ata_device (struct ata_disk *d)
   capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
+
+  /* Use DMA if both the controller and the disk support it. */
+  d->use_dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100);
+
+  /* For PIO, move as many sectors per interrupt as the disk
+     allows. */
+  multiple_cnt = *(uint16_t *) &id[47 * 2] & 0xff;
+  if (multiple_cnt > 1 && set_multiple_mode (d, multiple_cnt))
+    d->multiple_cnt = multiple_cnt;
+  lock_release (&c->lock);
+
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\"%s", model, serial,
+            d->use_dma ? ", DMA" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -309,6 +495,23 @@ identify_ata_device (struct ata_disk *d)
   partition_scan (block);
 }
 
+/* Sends a SET MULTIPLE MODE command to disk D so that READ
+   MULTIPLE and WRITE MULTIPLE transfer CNT sectors per
+   interrupt.  Returns true if the disk accepted it.
+   D's channel must be locked. */
+static bool
+set_multiple_mode (struct ata_disk *d, int cnt) 
+{
+  struct channel *c = d->channel;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), cnt);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  return (inb (reg_status (c)) & STA_ERR) == 0;
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,63 +540,355 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Returns true if BUFFER can be the target of a DMA transfer,
+   which must start at an even physical address. */
+static bool
+dma_buffer_ok (const void *buffer) 
+{
+  return ((uintptr_t) buffer & 1) == 0;
+}
+
+/* Transfers the CNT sectors starting at SEC_NO between disk D
+   and BUFFER, in the direction given by WRITE, with as few
+   commands as possible.  D's channel must be locked. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+transfer (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+          uint8_t *buffer, bool write)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  while (cnt > 0)
+    {
+      size_t n = cnt < CMD_MAX_SECTORS ? cnt : CMD_MAX_SECTORS;
+      if (!d->use_dma || !dma_buffer_ok (buffer)
+          || !dma_transfer (d, sec_no, buffer, n, write))
+        {
+          if (write)
+            pio_write (d, sec_no, buffer, n);
+          else
+            pio_read (d, sec_no, buffer, n);
+        }
+      sec_no += n;
+      buffer += n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Returns the elevator key of REQ, which orders requests to
+   both disks on a channel, those to the master first. */
+static uint32_t
+request_key (const struct block_request *req)
+{
+  const struct ata_disk *d = req->driver_data;
+  return ((uint32_t) d->dev_no << 28) + req->sector;
+}
+
+/* Returns true if request A's key is less than request B's. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request,
+                                              elem);
+  const struct block_request *b = list_entry (b_, struct block_request,
+                                              elem);
+  return request_key (a) < request_key (b);
+}
+
+/* Queues REQ for disk D and wakes up D's channel's dispatcher. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_submit (void *d_, struct block_request *req)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+
+  req->driver_data = d;
+
+  lock_acquire (&c->queue_lock);
+  list_insert_ordered (&c->queue, &req->elem, request_less, NULL);
+  c->depth++;
+  c->depth_sum += c->depth;
+  if (c->depth > c->max_depth)
+    c->max_depth = c->depth;
+  cond_signal (&c->queue_nonempty, &c->queue_lock);
+  lock_release (&c->queue_lock);
+}
+
+/* Removes and returns the request in channel C's queue that
+   C-LOOK serves next: the first one at or past C's head, or the
+   first one of all if there is none.  C's queue must be locked
+   and non-empty. */
+static struct block_request *
+next_request (struct channel *c)
+{
+  struct list_elem *e;
+  struct block_request *req;
+
+  ASSERT (!list_empty (&c->queue));
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    if (request_key (list_entry (e, struct block_request, elem)) >= c->head)
+      break;
+  if (e == list_end (&c->queue))
+    e = list_begin (&c->queue);
+
+  req = list_entry (list_remove (e), struct block_request, elem);
+  c->head = request_key (req) + req->cnt;
+  return req;
+}
+
+/* Dispatch thread for channel C_.  Carries out the requests in
+   the channel's queue one after another. */
+static void
+dispatch_thread (void *c_)
+{
+  struct channel *c = c_;
+
+  for (;;)
+    {
+      struct block_request *req;
+      uint64_t start, end;
+
+      lock_acquire (&c->queue_lock);
+      while (list_empty (&c->queue))
+        cond_wait (&c->queue_nonempty, &c->queue_lock);
+      req = next_request (c);
+      lock_release (&c->queue_lock);
+
+      start = timer_read_tsc ();
+      lock_acquire (&c->lock);
+      transfer (req->driver_data, req->sector, req->cnt, req->buffer,
+                req->write);
+      lock_release (&c->lock);
+      end = timer_read_tsc ();
+
+      lock_acquire (&c->queue_lock);
+      c->depth--;
+      c->request_cnt++;
+      c->wait_cycles += start - req->submit_time;
+      c->service_cycles += end - start;
+      lock_release (&c->queue_lock);
+
+      block_complete (req);
+    }
 }
 
 static struct block_operations ide_operations =
   {
-    ide_read,
-    ide_write
+    .submit = ide_submit
   };
+
+/* Adds CNT sectors that took CYCLES of CPU time to STATS. */
+static void
+account_xfer (struct xfer_stats *stats, size_t cnt, uint64_t cycles) 
+{
+  stats->sector_cnt += cnt;
+  stats->cycles += cycles;
+}
+
+/* Prints STATS for transfer mode NAME. */
+static void
+print_xfer_stats (const char *name, const struct xfer_stats *stats) 
+{
+  /* 2048 sectors make a megabyte. */
+  printf ("%s %llu sectors, %"PRIu64" cycles/MB", name, stats->sector_cnt,
+          stats->sector_cnt != 0
+          ? stats->cycles * 2048 / stats->sector_cnt : 0);
+}
+
+/* Prints the CPU time spent per megabyte moved by PIO and by
+   DMA.  Time spent waiting for the disk, during which other
+   threads may run, is not counted.  Then, for each channel that
+   served requests, prints the average number of requests queued
+   or in progress as each one arrived, and the average time that
+   requests waited in the queue and then took to carry out. */
+void
+ide_print_stats (void) 
+{
+  size_t chan_no;
+
+  printf ("IDE: ");
+  print_xfer_stats ("PIO", &pio_stats);
+  printf (", ");
+  print_xfer_stats ("DMA", &dma_stats);
+  printf ("\n");
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      struct channel *c = &channels[chan_no];
+      unsigned long long n = c->request_cnt;
+      unsigned long long depth;
+
+      if (n == 0)
+        continue;
+      depth = c->depth_sum * 100 / n;
+      printf ("%s: %llu requests, queue depth %llu.%02llu avg, %zu max, "
+              "wait %"PRIu64" cycles avg, service %"PRIu64" cycles avg\n",
+              c->name, n, depth / 100, depth % 100, c->max_depth,
+              c->wait_cycles / n, c->service_cycles / n);
+    }
+}
+
+/* Reads CNT sectors, at most CMD_MAX_SECTORS, starting at SEC_NO
+   from disk D into BUFFER by PIO.  The disk interrupts once per
+   block of D's multiple_cnt sectors.
+   D's channel must be locked. */
+static void
+pio_read (struct ata_disk *d, block_sector_t sec_no, void *buffer,
+          size_t cnt) 
+{
+  struct channel *c = d->channel;
+  uint64_t start = timer_read_tsc ();
+  uint64_t waited = 0;
+  uint8_t *p = buffer;
+  size_t left, i;
+
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, d->multiple_cnt > 1
+                        ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+  for (left = cnt; left > 0; )
+    {
+      size_t block_cnt = left < (size_t) d->multiple_cnt
+                         ? left : (size_t) d->multiple_cnt;
+
+      waited += wait_for_completion (c);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu,
+               d->name, sec_no + (cnt - left));
+      for (i = 0; i < block_cnt; i++, p += BLOCK_SECTOR_SIZE)
+        input_sector (c, p);
+      left -= block_cnt;
+    }
+  account_xfer (&pio_stats, cnt, timer_read_tsc () - start - waited);
+}
+
+/* Writes CNT sectors, at most CMD_MAX_SECTORS, starting at SEC_NO
+   to disk D from BUFFER by PIO.  The disk interrupts once per
+   block of D's multiple_cnt sectors.
+   D's channel must be locked. */
+static void
+pio_write (struct ata_disk *d, block_sector_t sec_no, const void *buffer,
+           size_t cnt) 
+{
+  struct channel *c = d->channel;
+  uint64_t start = timer_read_tsc ();
+  uint64_t waited = 0;
+  const uint8_t *p = buffer;
+  size_t left, i;
+
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, d->multiple_cnt > 1
+                        ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+  for (left = cnt; left > 0; )
+    {
+      size_t block_cnt = left < (size_t) d->multiple_cnt
+                         ? left : (size_t) d->multiple_cnt;
+
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu,
+               d->name, sec_no + (cnt - left));
+      for (i = 0; i < block_cnt; i++, p += BLOCK_SECTOR_SIZE)
+        output_sector (c, p);
+      waited += wait_for_completion (c);
+      left -= block_cnt;
+    }
+  account_xfer (&pio_stats, cnt, timer_read_tsc () - start - waited);
+}
+
+/* Fills in the PRD table of channel C to describe the SIZE
+   bytes of BUFFER. */
+static void
+build_prd_table (struct channel *c, void *buffer, size_t size) 
+{
+  uintptr_t addr = vtop (buffer);
+  struct prd *prd = c->prdt;
+
+  ASSERT (size > 0);
+  for (;;)
+    {
+      /* Stop each piece at the next 64 kB boundary. */
+      size_t piece = 0x10000 - (addr & 0xffff);
+      if (piece > size)
+        piece = size;
+
+      ASSERT (prd < c->prdt + PRD_CNT);
+      prd->addr = addr;
+      prd->size = piece & 0xffff;
+      prd->flags = 0;
+
+      addr += piece;
+      size -= piece;
+      if (size == 0)
+        break;
+      prd++;
+    }
+  prd->flags = PRD_EOT;
+}
+
+/* Transfers CNT sectors starting at SEC_NO between disk D and
+   BUFFER by DMA, from the disk into BUFFER if WRITE is false and
+   the other way around if it is true.  D's channel must be
+   locked.
+
+   Returns true if successful.  On failure, stops using DMA for
+   D and returns false, so that the caller can fall back to PIO. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, void *buffer,
+              size_t cnt, bool write) 
+{
+  struct channel *c = d->channel;
+  uint8_t direction = write ? 0 : BMC_READ;
+  uint64_t start = timer_read_tsc ();
+  uint64_t waited;
+  uint8_t bm_stat, status;
+
+  ASSERT (cnt > 0 && cnt <= CMD_MAX_SECTORS);
+  ASSERT (is_kernel_vaddr (buffer));
+  ASSERT (dma_buffer_ok (buffer));
+
+  /* Program the bus master, with the transfer stopped, and
+     clear its error and interrupt bits. */
+  build_prd_table (c, buffer, cnt * BLOCK_SECTOR_SIZE);
+  outl (bm_prdt (c), vtop (c->prdt));
+  outb (bm_command (c), direction);
+  outb (bm_status (c), BMS_ERROR | BMS_INTR);
+
+  /* Issue the command, then let the bus master go. */
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (bm_command (c), direction | BMC_START);
+  waited = wait_for_completion (c);
+
+  /* Stop the bus master and check how it went. */
+  outb (bm_command (c), direction);
+  bm_stat = inb (bm_status (c));
+  outb (bm_status (c), BMS_ERROR | BMS_INTR);
+  status = inb (reg_status (c));
+  if ((bm_stat & BMS_ERROR) || (status & (STA_ERR | STA_DF)))
+    {
+      printf ("%s: DMA %s failed, sector=%"PRDSNu", using PIO\n",
+              d->name, write ? "write" : "read", sec_no);
+      d->use_dma = false;
+      return false;
+    }
+
+  account_xfer (&dma_stats, cnt, timer_read_tsc () - start - waited);
+  return true;
+}
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the count CNT of sectors to transfer, at
+   most 256, to the disk's sector selection registers.  (We use
+   LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= 256);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt & 0xff);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -430,6 +925,17 @@ output_sector (struct channel *c, const void *sector)
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
+/* Waits for the interrupt that signals completion of the
+   command issued on channel C.  Returns the CPU cycles that
+   passed meanwhile, during which other threads could run. */
+static uint64_t
+wait_for_completion (struct channel *c) 
+{
+  uint64_t start = timer_read_tsc ();
+  sema_down (&c->completion_wait);
+  return timer_read_tsc () - start;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -24,7 +24,43 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Hierarchical timer wheel holding the pending kernel timers.
+
+   WHEEL0 has one slot for each of the next WHEEL0_SIZE ticks.
+   Each slot of the first outer wheel covers one whole turn of
+   WHEEL0, each slot of the second outer wheel one whole turn of
+   the first, and so on.  Whenever a wheel completes a turn, the
+   timers in the next slot of the wheel outside it are
+   "cascaded", that is, redistributed over the inner wheels.
+   Adding or cancelling a timer thus takes constant time, and so
+   does each tick, amortized, no matter how many timers are
+   pending.  Timers further out than WHEEL_SPAN ticks are parked
+   in the outermost wheel and re-filed whenever cascaded. */
+#define WHEEL0_BITS 8
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEEL0_MASK (WHEEL0_SIZE - 1)
+#define WHEELN_BITS 6
+#define WHEELN_SIZE (1 << WHEELN_BITS)
+#define WHEELN_MASK (WHEELN_SIZE - 1)
+#define WHEELN_CNT 4
+#define WHEEL_SPAN ((int64_t) 1 << (WHEEL0_BITS + WHEELN_CNT * WHEELN_BITS))
+
+static struct list wheel0[WHEEL0_SIZE];
+static struct list wheeln[WHEELN_CNT][WHEELN_SIZE];
+
+/* Next tick whose timers have not been run yet. */
+static int64_t wheel_ticks;
+
+/* Statistics. */
+static uint64_t max_interrupt_cycles;   /* Longest timer_interrupt(). */
+static uint64_t total_interrupt_cycles; /* Sum over all timer_interrupt()s. */
+static long long timer_fire_cnt;        /* # of kernel timers fired. */
+
 static intr_handler_func timer_interrupt;
+static void wheel_insert (struct timer_event *);
+static void wheel_cascade (int level);
+static void wheel_advance (void);
+static timer_func wake_sleeper;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -35,6 +71,15 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  int i, j;
+
+  for (i = 0; i < WHEEL0_SIZE; i++)
+    list_init (&wheel0[i]);
+  for (i = 0; i < WHEELN_CNT; i++)
+    for (j = 0; j < WHEELN_SIZE; j++)
+      list_init (&wheeln[i][j]);
+  wheel_ticks = 0;
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -90,11 +135,19 @@ void
 timer_sleep (int64_t ticks) 
 {
   int64_t start = timer_ticks ();
+  struct timer_event wakeup;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-
-  int64_t wakeup_ticks = start + ticks;
-  thread_sleep (wakeup_ticks);
+  if (ticks <= 0)
+    return;
+
+  /* WAKEUP lives on our stack, which stays put while we are
+     blocked. */
+  old_level = intr_disable ();
+  timer_add (&wakeup, start + ticks, wake_sleeper, thread_current ());
+  thread_block ();
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -121,6 +174,49 @@ timer_nsleep (int64_t ns)
   real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Arranges for FUNC to be called with E and AUX once the timer
+   tick count reaches EXPIRES, or at the next tick if it already
+   has.  E must not already be pending.
+
+   FUNC runs in the timer interrupt handler, so it must not
+   sleep.  It may add E again to make a periodic timer. */
+void
+timer_add (struct timer_event *e, int64_t expires, timer_func *func,
+           void *aux)
+{
+  enum intr_level old_level;
+
+  ASSERT (e != NULL);
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  e->expires = expires;
+  e->func = func;
+  e->aux = aux;
+  e->pending = true;
+  wheel_insert (e);
+  intr_set_level (old_level);
+}
+
+/* Cancels timer E.  Returns true if E was pending, false if it
+   had already fired or had been cancelled before. */
+bool
+timer_cancel (struct timer_event *e)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  old_level = intr_disable ();
+  was_pending = e->pending;
+  if (was_pending)
+    {
+      list_remove (&e->elem);
+      e->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
 /* Busy-waits for approximately MS milliseconds.  Interrupts need
    not be turned on.
 
@@ -164,16 +260,27 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  int64_t t = timer_ticks ();
+
+  printf ("Timer: %"PRId64" ticks\n", t);
+  printf ("Timer: %lld kernel timers fired, "
+          "longest interrupt %"PRIu64" cycles, "
+          "average %"PRIu64" cycles\n",
+          timer_fire_cnt, max_interrupt_cycles,
+          t > 0 ? total_interrupt_cycles / t : 0);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+  uint64_t start = timer_read_tsc ();
+  uint64_t cycles;
+
   ticks++;
   thread_tick ();
-  thread_wakeup (ticks);
+  while (wheel_ticks <= ticks)
+    wheel_advance ();
 
   if (thread_mlfqs)
     {
@@ -181,19 +288,129 @@ timer_interrupt (struct intr_frame *args UNUSED)
          fot not-­idle running thread only. */
       mlfqs_increment_recent_cpu ();
 
-      /* Once per second, `recent_cpu' is recalculated for
-         every thread, and `load_avg' is also updated. */
+      /* Once per second, `load_avg' is updated and `recent_cpu'
+         decays.  Blocked threads catch up on the decay when they
+         wake up. */
       if (timer_ticks () % TIMER_FREQ == 0)
         {
           mlfqs_update_load_avg ();
-          thread_foreach (mlfqs_recalc_recent_cpu, NULL);
+          mlfqs_decay_recent_cpu ();
         }
 
-      /* For every thread, priority is recalculated
+      /* Between decays, only the running thread's `recent_cpu'
+         changes, so only its priority needs to be recalculated
          every fourth tick. */
       if (timer_ticks () % 4 == 0)
-        thread_foreach (mlfqs_recalc_priority, NULL);
+        mlfqs_recalc_priority (thread_current ());
+    }
+
+  cycles = timer_read_tsc () - start;
+  total_interrupt_cycles += cycles;
+  if (cycles > max_interrupt_cycles)
+    max_interrupt_cycles = cycles;
+}
+
+/* Files pending timer E in the wheel slot for its expiry time. */
+static void
+wheel_insert (struct timer_event *e)
+{
+  int64_t expires = e->expires;
+  int64_t delta = expires - wheel_ticks;
+  struct list *slot;
+
+  if (delta < 0)
+    {
+      /* Already due.  Run on the next tick processed. */
+      slot = &wheel0[wheel_ticks & WHEEL0_MASK];
     }
+  else if (delta < WHEEL0_SIZE)
+    slot = &wheel0[expires & WHEEL0_MASK];
+  else
+    {
+      int level;
+      int shift;
+
+      if (delta >= WHEEL_SPAN)
+        {
+          delta = WHEEL_SPAN - 1;
+          expires = wheel_ticks + delta;
+        }
+      for (level = 0; ; level++)
+        {
+          shift = WHEEL0_BITS + level * WHEELN_BITS;
+          if (delta < (int64_t) 1 << (shift + WHEELN_BITS))
+            break;
+        }
+      slot = &wheeln[level][(expires >> shift) & WHEELN_MASK];
+    }
+  list_push_back (slot, &e->elem);
+}
+
+/* Re-files the timers in the current slot of outer wheel LEVEL
+   into the wheels inside it. */
+static void
+wheel_cascade (int level)
+{
+  int shift = WHEEL0_BITS + level * WHEELN_BITS;
+  struct list *slot = &wheeln[level][(wheel_ticks >> shift) & WHEELN_MASK];
+  struct list timers;
+
+  /* Detach the slot first, since a far-off timer may be filed
+     right back into it. */
+  list_init (&timers);
+  if (!list_empty (slot))
+    list_splice (list_end (&timers), list_begin (slot), list_end (slot));
+
+  while (!list_empty (&timers))
+    wheel_insert (list_entry (list_pop_front (&timers),
+                              struct timer_event, elem));
+}
+
+/* Runs the timers due at tick wheel_ticks and advances
+   wheel_ticks by one, cascading outer wheels as they turn. */
+static void
+wheel_advance (void)
+{
+  struct list *slot = &wheel0[wheel_ticks & WHEEL0_MASK];
+  struct list expired;
+
+  if ((wheel_ticks & WHEEL0_MASK) == 0)
+    {
+      int level;
+
+      for (level = 0; level < WHEELN_CNT; level++)
+        {
+          int shift = WHEEL0_BITS + level * WHEELN_BITS;
+          wheel_cascade (level);
+          if (((wheel_ticks >> shift) & WHEELN_MASK) != 0)
+            break;
+        }
+    }
+
+  /* Detach the expired timers before running them, so that
+     timers added by their callbacks are filed against the new
+     wheel_ticks. */
+  list_init (&expired);
+  if (!list_empty (slot))
+    list_splice (list_end (&expired), list_begin (slot), list_end (slot));
+  wheel_ticks++;
+
+  while (!list_empty (&expired))
+    {
+      struct timer_event *e = list_entry (list_pop_front (&expired),
+                                          struct timer_event, elem);
+      e->pending = false;
+      timer_fire_cnt++;
+      e->func (e, e->aux);
+    }
+}
+
+/* Timer callback that wakes up the thread AUX that called
+   timer_sleep(). */
+static void
+wake_sleeper (struct timer_event *e UNUSED, void *aux)
+{
+  thread_unblock (aux);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
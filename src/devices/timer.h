@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -19,6 +21,35 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* Kernel timers. */
+struct timer_event;
+typedef void timer_func (struct timer_event *, void *aux);
+
+/* A one-shot kernel timer, set with timer_add().  The caller
+   owns the storage, which must stay valid until the timer has
+   fired or been cancelled. */
+struct timer_event
+  {
+    int64_t expires;                    /* Tick at which to fire. */
+    timer_func *func;                   /* Called on expiry. */
+    void *aux;                          /* Passed to FUNC. */
+    bool pending;                       /* Added and not yet fired? */
+    struct list_elem elem;              /* Timer wheel slot element. */
+  };
+
+void timer_add (struct timer_event *, int64_t expires, timer_func *, void *aux);
+bool timer_cancel (struct timer_event *);
+
+/* Returns the CPU's time-stamp counter, which counts CPU
+   cycles. */
+static inline uint64_t
+timer_read_tsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
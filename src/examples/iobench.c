@@ -0,0 +1,95 @@
+/* iobench.c
+
+   Writes and then reads back a file using 1 kB, 64 kB and 1 MB
+   requests, to measure read and write throughput for each
+   request size.  User programs have no clock, so the kernel
+   times the requests itself and prints the throughput in MB/s
+   for each size at power-off, e.g.:
+
+     pintos -v -k -m 8 --filesys-size=8 -p iobench -a iobench \
+       -- -q -f run iobench
+
+   The optional argument sets the number of bytes transferred per
+   request size, 2 MB by default. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define MAX_REQUEST (1024 * 1024)
+
+static char buf[MAX_REQUEST];
+
+static const char file_name[] = "iobench.dat";
+
+/* Writes TOTAL bytes to a new file in REQUEST-byte requests,
+   reads them back the same way, and checks the data.  Returns
+   true if successful, false on failure. */
+static bool
+run (int request, int total) 
+{
+  int fd, ofs;
+
+  if (!create (file_name, 0)) 
+    {
+      printf ("%s: create failed\n", file_name);
+      return false;
+    }
+  fd = open (file_name);
+  if (fd < 0) 
+    {
+      printf ("%s: open failed\n", file_name);
+      return false;
+    }
+
+  for (ofs = 0; ofs < total; ofs += request) 
+    {
+      memset (buf, ofs / request, request);
+      if (write (fd, buf, request) != request) 
+        {
+          printf ("%s: write failed\n", file_name);
+          return false;
+        }
+    }
+
+  seek (fd, 0);
+  for (ofs = 0; ofs < total; ofs += request) 
+    if (read (fd, buf, request) != request
+        || buf[0] != (char) (ofs / request)
+        || buf[request - 1] != (char) (ofs / request)) 
+      {
+        printf ("%s: read failed\n", file_name);
+        return false;
+      }
+
+  close (fd);
+  remove (file_name);
+
+  printf ("iobench: %d-byte requests: wrote and read %d bytes\n",
+          request, total);
+  return true;
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  static const int requests[] = {1024, 64 * 1024, MAX_REQUEST};
+  int total = 2 * 1024 * 1024;
+  size_t i;
+
+  if (argc > 1)
+    total = atoi (argv[1]);
+  if (total < MAX_REQUEST) 
+    {
+      printf ("usage: iobench [BYTES], with BYTES at least %d\n",
+              MAX_REQUEST);
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < sizeof requests / sizeof *requests; i++)
+    if (!run (requests[i], total / requests[i] * requests[i]))
+      return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,459 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.  Keeps up to CACHE_SIZE sectors of the file
+   system device in memory, so that repeated accesses to the
+   same sector, and partial-sector reads and writes, do not go
+   to the disk every time.
+
+   Replacement uses the clock algorithm over the fixed array of
+   entries.  Writes only mark an entry dirty: dirty entries are
+   written back when they are evicted, periodically by the
+   "cache-flush" thread, and finally by cache_flush() when the
+   file system shuts down.  Sequential readers additionally ask
+   the "cache-readahead" thread to bring in the next sector
+   while they are busy with the current one. */
+
+/* Number of cached sectors. */
+#define CACHE_SIZE 64
+
+/* Ticks between two periodic write-behind passes. */
+#define CACHE_FLUSH_INTERVAL (5 * TIMER_FREQ)
+
+/* Maximum number of pending read-ahead requests.  Requests that
+   arrive when the queue is full are simply dropped. */
+#define READAHEAD_QUEUE_SIZE 16
+
+/* A cached sector.
+
+   SECTOR and VALID may only be changed while holding both
+   cache_lock and the entry's LOCK, so holding either one is
+   enough to read them.  ACCESSED is protected by cache_lock.
+   DIRTY and DATA are protected by the entry's LOCK.
+
+   An entry chosen for eviction while dirty is written back with
+   its LOCK held but without cache_lock.  Meanwhile it still
+   caches its old sector, so accesses to that sector wait on
+   LOCK and then find the entry clean, while the rest of the
+   cache stays usable. */
+struct cache_entry
+  {
+    block_sector_t sector;              /* Cached sector number. */
+    bool valid;                         /* Does this entry cache SECTOR? */
+    bool accessed;                      /* Referenced since last clock sweep? */
+    bool dirty;                         /* Modified since last written back? */
+    struct lock lock;                   /* Protects DIRTY and DATA. */
+    struct block_request req;           /* For cache_flush() write-back. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+/* Cache entries and the clock hand over them. */
+static struct cache_entry cache[CACHE_SIZE];
+static size_t hand;
+
+/* Protects the mapping from sectors to cache entries. */
+static struct lock cache_lock;
+
+/* Threads that found every entry locked wait on ENTRY_RELEASED,
+   under cache_lock, until an entry's lock is released.
+   EVICT_WAITERS counts them, so that releases need not take
+   cache_lock when nobody waits. */
+static struct condition entry_released;
+static int evict_waiters;
+
+/* Pending read-ahead requests, a circular queue. */
+static block_sector_t readahead_queue[READAHEAD_QUEUE_SIZE];
+static size_t readahead_head;           /* Index of oldest request. */
+static size_t readahead_cnt;            /* Number of requests queued. */
+static struct lock readahead_lock;
+static struct condition readahead_cond;
+
+/* Statistics. */
+static unsigned long long hit_cnt;      /* # of accesses found in cache. */
+static unsigned long long miss_cnt;     /* # of accesses that missed. */
+static unsigned long long writeback_cnt;        /* # of sectors written. */
+static unsigned long long readahead_fill_cnt;   /* # of sectors read ahead. */
+
+static struct cache_entry *cache_get (block_sector_t, bool fill, bool *hit);
+static struct cache_entry *cache_find (block_sector_t);
+static struct cache_entry *cache_evict (void);
+static struct cache_entry *clock_sweep (size_t step_cnt);
+static void cache_writeback (struct cache_entry *);
+static void entry_release (struct cache_entry *);
+static thread_func flush_daemon NO_RETURN;
+static thread_func readahead_daemon NO_RETURN;
+
+/* Initializes the buffer cache and starts its write-behind and
+   read-ahead threads. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  cond_init (&entry_released);
+  evict_waiters = 0;
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].valid = false;
+      cache[i].accessed = false;
+      cache[i].dirty = false;
+      lock_init (&cache[i].lock);
+    }
+  hand = 0;
+
+  lock_init (&readahead_lock);
+  cond_init (&readahead_cond);
+  readahead_head = readahead_cnt = 0;
+
+  thread_create ("cache-flush", PRI_DEFAULT, flush_daemon, NULL);
+  thread_create ("cache-readahead", PRI_DEFAULT, readahead_daemon, NULL);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within SECTOR of
+   the file system device into BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+  bool hit;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get (sector, true, &hit);
+  if (hit)
+    hit_cnt++;
+  else
+    miss_cnt++;
+  memcpy (buffer, e->data + ofs, size);
+  entry_release (e);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR of the file system
+   device, starting at byte offset OFS within the sector.  The
+   data reaches the disk later, see cache_flush(). */
+void
+cache_write_at (block_sector_t sector, const void *buffer,
+                size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+  bool hit;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  /* A write covering the whole sector need not read the old
+     contents first. */
+  e = cache_get (sector, size < BLOCK_SECTOR_SIZE, &hit);
+  if (hit)
+    hit_cnt++;
+  else
+    miss_cnt++;
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  entry_release (e);
+}
+
+/* Returns true if SECTOR is in the cache.  A sector that is not
+   cached has no changes waiting to be written back, so the disk
+   holds its current contents. */
+bool
+cache_contains (block_sector_t sector)
+{
+  bool found;
+
+  lock_acquire (&cache_lock);
+  found = cache_find (sector) != NULL;
+  lock_release (&cache_lock);
+  return found;
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache in
+   the background.  Returns immediately. */
+void
+cache_readahead (block_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  if (readahead_cnt < READAHEAD_QUEUE_SIZE)
+    {
+      size_t tail = (readahead_head + readahead_cnt) % READAHEAD_QUEUE_SIZE;
+      readahead_queue[tail] = sector;
+      readahead_cnt++;
+      cond_signal (&readahead_cond, &readahead_lock);
+    }
+  lock_release (&readahead_lock);
+}
+
+/* Writes every dirty cache entry back to disk.  All of the
+   writes are submitted before waiting for any of them, so that
+   the disk driver can order them to save seeks. */
+void
+cache_flush (void)
+{
+  bool pending[CACHE_SIZE];
+  size_t i;
+
+  /* Disk I/O needs interrupts.  They are only off here if we are
+     being called on the way down from a kernel panic, in which
+     case there is nothing sensible left to do. */
+  if (intr_get_level () == INTR_OFF)
+    return;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      lock_acquire (&e->lock);
+      pending[i] = e->valid && e->dirty;
+      if (pending[i])
+        {
+          block_request_init (&e->req, e->sector, 1, e->data, true,
+                              NULL, NULL);
+          block_submit (fs_device, &e->req);
+        }
+      else
+        entry_release (e);
+    }
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (pending[i])
+      {
+        struct cache_entry *e = &cache[i];
+        block_wait (&e->req);
+        e->dirty = false;
+        writeback_cnt++;
+        entry_release (e);
+      }
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %llu hits, %llu misses, %llu read-aheads, "
+          "%llu write-backs\n",
+          hit_cnt, miss_cnt, readahead_fill_cnt, writeback_cnt);
+}
+
+/* Returns the cache entry for SECTOR, with its lock held.  If
+   SECTOR is not cached, evicts some other entry to make room
+   and, if FILL is true, reads SECTOR from disk into it.
+   Sets *HIT to true if SECTOR was already cached. */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool fill, bool *hit)
+{
+  struct cache_entry *e;
+
+  for (;;)
+    {
+      lock_acquire (&cache_lock);
+      e = cache_find (sector);
+      if (e != NULL)
+        {
+          e->accessed = true;
+          lock_release (&cache_lock);
+
+          /* E may have been recycled for another sector while we
+             waited for its lock.  If so, start over. */
+          lock_acquire (&e->lock);
+          if (e->valid && e->sector == sector)
+            {
+              *hit = true;
+              return e;
+            }
+          entry_release (e);
+          continue;
+        }
+
+      e = cache_evict ();
+      if (e->valid && e->dirty)
+        {
+          /* Write the victim back without cache_lock, then start
+             over: SECTOR may have been cached meanwhile, and the
+             victim, now clean, is the clock's next choice. */
+          lock_release (&cache_lock);
+          cache_writeback (e);
+          entry_release (e);
+          continue;
+        }
+
+      /* Claim the victim for SECTOR before dropping cache_lock,
+         so that concurrent accesses to SECTOR find this entry
+         and wait on its lock until the data is in place. */
+      e->sector = sector;
+      e->valid = true;
+      e->accessed = true;
+      lock_release (&cache_lock);
+
+      if (fill)
+        block_read (fs_device, sector, e->data);
+      *hit = false;
+      return e;
+    }
+}
+
+/* Returns the entry caching SECTOR, or a null pointer if there
+   is none.  The caller must hold cache_lock. */
+static struct cache_entry *
+cache_find (block_sector_t sector)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Chooses an entry to reuse with the clock algorithm and returns
+   it with its lock held.  A clean entry is returned invalidated.
+   A dirty one is returned still caching its sector, for the
+   caller to write back after releasing cache_lock.  If every
+   entry is locked, waits for one to be released.  The caller
+   must hold cache_lock. */
+static struct cache_entry *
+cache_evict (void)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (;;)
+    {
+      struct cache_entry *e = clock_sweep (2 * CACHE_SIZE);
+      if (e != NULL)
+        return e;
+
+      /* Every entry is in use by some thread.  Register as a
+         waiter before looking once more, so that a release in
+         between is not missed. */
+      evict_waiters++;
+      e = clock_sweep (CACHE_SIZE);
+      if (e == NULL)
+        cond_wait (&entry_released, &cache_lock);
+      evict_waiters--;
+      if (e != NULL)
+        return e;
+    }
+}
+
+/* Advances the clock hand up to STEP_CNT times looking for an
+   entry to evict, and returns it with its lock held, or returns
+   a null pointer if there is none.  The caller must hold
+   cache_lock. */
+static struct cache_entry *
+clock_sweep (size_t step_cnt)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  while (step_cnt-- > 0)
+    {
+      struct cache_entry *e = &cache[hand];
+      hand = (hand + 1) % CACHE_SIZE;
+
+      if (!e->valid)
+        {
+          if (lock_try_acquire (&e->lock))
+            return e;
+          continue;
+        }
+      if (e->accessed)
+        {
+          e->accessed = false;
+          continue;
+        }
+      if (!lock_try_acquire (&e->lock))
+        continue;
+
+      if (!e->dirty)
+        e->valid = false;
+      return e;
+    }
+  return NULL;
+}
+
+/* Writes dirty entry E back to disk.  The caller must hold E's
+   lock. */
+static void
+cache_writeback (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&e->lock));
+  ASSERT (e->valid && e->dirty);
+
+  block_write (fs_device, e->sector, e->data);
+  e->dirty = false;
+  writeback_cnt++;
+}
+
+/* Releases E's lock and wakes up any threads waiting for an
+   entry to evict.  The caller must not hold cache_lock. */
+static void
+entry_release (struct cache_entry *e)
+{
+  lock_release (&e->lock);
+  if (evict_waiters > 0)
+    {
+      lock_acquire (&cache_lock);
+      cond_broadcast (&entry_released, &cache_lock);
+      lock_release (&cache_lock);
+    }
+}
+
+/* Write-behind thread.  Periodically writes all dirty entries
+   back to disk, so that a crash loses at most the last
+   CACHE_FLUSH_INTERVAL ticks worth of writes.  The free map
+   keeps its own changes out of the cache until asked, so they
+   are pushed in first. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (CACHE_FLUSH_INTERVAL);
+      free_map_flush ();
+      cache_flush ();
+    }
+}
+
+/* Read-ahead thread.  Brings requested sectors into the cache
+   if they are not there already. */
+static void
+readahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+      bool present;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_cond, &readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_QUEUE_SIZE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      lock_acquire (&cache_lock);
+      present = cache_find (sector) != NULL;
+      lock_release (&cache_lock);
+
+      if (!present)
+        {
+          struct cache_entry *e;
+          bool hit;
+
+          e = cache_get (sector, true, &hit);
+          if (!hit)
+            readahead_fill_cnt++;
+          entry_release (e);
+        }
+    }
+}
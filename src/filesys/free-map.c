@@ -1,40 +1,76 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* Sectors of the free map file that differ from the in-memory
+   free map, one bit per sector of the file.
+
+   Allocating and releasing sectors only updates the in-memory
+   free map and marks the affected file sectors here.
+   free_map_flush() writes back just those sectors, periodically
+   from the buffer cache's write-behind thread and finally when
+   the free map is closed.
+
+   Crash consistency: free_map_flush() always runs just before
+   the buffer cache is flushed, so the free map reaches the disk
+   together with the inodes and directories whose allocations it
+   records.  A crash between flushes loses those changes along
+   with everything else still in the cache.  A crash in the
+   middle of a flush can leave the on-disk free map out of step
+   with them, since the cache writes sectors back in no
+   particular order: sectors may be leaked or, worse, be in use
+   yet marked free.  Pintos has no fsck to repair either. */
+static struct bitmap *dirty_sectors;
+
+/* Protects free_map and dirty_sectors. */
+static struct lock free_map_lock;
+
+/* Number of free map bits stored in one sector of its file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+static void mark_dirty (block_sector_t, size_t cnt);
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  lock_init (&free_map_lock);
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  dirty_sectors = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                               BLOCK_SECTOR_SIZE));
+  if (dirty_sectors == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
-    {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
-    }
+  block_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  sector = bitmap_scan_and_flip_next (free_map, cnt, false);
+  if (sector != BITMAP_ERROR)
+    mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
+
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
@@ -44,9 +80,37 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
+}
+
+/* Writes the sectors of the free map file that have changed
+   since they were last written. */
+void
+free_map_flush (void) 
+{
+  size_t bit_cnt = bitmap_size (free_map);
+  size_t i;
+
+  /* Not open yet, or on the way down from a kernel panic. */
+  if (free_map_file == NULL || intr_get_level () == INTR_OFF)
+    return;
+
+  lock_acquire (&free_map_lock);
+  for (i = 0; i < bitmap_size (dirty_sectors); i++)
+    if (bitmap_test (dirty_sectors, i))
+      {
+        size_t start = i * BITS_PER_SECTOR;
+        size_t cnt = bit_cnt - start < BITS_PER_SECTOR
+                     ? bit_cnt - start : BITS_PER_SECTOR;
+        if (!bitmap_write_range (free_map, free_map_file, start, cnt))
+          PANIC ("can't write free map");
+        bitmap_reset (dirty_sectors, i);
+      }
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,12 +122,14 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  bitmap_set_all (dirty_sectors, false);
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  free_map_flush ();
   file_close (free_map_file);
 }
 
@@ -76,10 +142,30 @@ free_map_create (void)
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
+  /* Write bitmap to file.  Writing it allocates the file's own
+     sectors, which may change parts of the bitmap already
+     written, so flush those afterward. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  free_map_flush ();
+}
+
+/* Marks the sectors of the free map file that hold the bits for
+   CNT sectors starting at SECTOR as dirty.  The caller must hold
+   free_map_lock. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first, last;
+
+  ASSERT (lock_held_by_current_thread (&free_map_lock));
+
+  if (cnt == 0)
+    return;
+  first = sector / BITS_PER_SECTOR;
+  last = (sector + cnt - 1) / BITS_PER_SECTOR;
+  bitmap_set_multiple (dirty_sectors, first, last - first + 1, true);
 }
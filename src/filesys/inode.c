@@ -2,33 +2,59 @@
 #include <list.h>
 #include <debug.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of sector pointers in the inode itself, and in an
+   indirect block. */
+#define DIRECT_CNT 124
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Largest possible file, in bytes. */
+#define INODE_MAX_LENGTH \
+        ((off_t) (DIRECT_CNT + PTRS_PER_SECTOR \
+                  + PTRS_PER_SECTOR * PTRS_PER_SECTOR) * BLOCK_SECTOR_SIZE)
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   The first DIRECT_CNT sectors of the file are found through
+   DIRECT, the next PTRS_PER_SECTOR through the indirect block,
+   whose sector holds an array of sector numbers, and the rest
+   through the doubly indirect block, an array of indirect
+   blocks.  Sectors, including indirect blocks, are allocated
+   only when first written, so a zero pointer marks a hole that
+   reads as zeros.  (Sector 0 holds the free map inode, so it is
+   never a data sector.) */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    block_sector_t direct[DIRECT_CNT];  /* Direct blocks. */
+    block_sector_t indirect;            /* Indirect block. */
+    block_sector_t doubly_indirect;     /* Doubly indirect block. */
   };
 
-/* Returns the number of sectors to allocate for an inode SIZE
-   bytes long. */
-static inline size_t
-bytes_to_sectors (off_t size)
-{
-  return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
-}
-
-/* In-memory inode. */
+/* In-memory inode.
+
+   ELEM and OPEN_CNT are protected by open_inodes_lock.  RW is
+   held for reading by readers and by writers that stay within
+   the file, which may all proceed at once, and for writing by
+   writers that extend the file, so that the length only changes
+   with nobody else inside.  DENY_WRITE_CNT only changes with RW
+   held for writing, so no write is under way when writes become
+   denied.  LOCK serializes the allocation of sectors.  DIR_LOCK is only used
+   by the directory code, see inode_lock().  READ_END is only a
+   hint for read-ahead, so readers update it without locking. */
 struct inode 
   {
     struct list_elem elem;              /* Element in inode list. */
@@ -36,39 +62,226 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    off_t read_end;                     /* Offset where last read ended. */
+    struct rwlock rw;                   /* Readers and writers. */
+    struct lock lock;                   /* Sector allocation. */
+    struct lock dir_lock;               /* Directory operations. */
     struct inode_disk data;             /* Inode content. */
   };
 
+static block_sector_t lookup_sector (struct inode *, off_t, bool create,
+                                     const void *data);
+
+/* Statistics. */
+static unsigned long long alloc_cnt;        /* Sectors allocated. */
+static unsigned long long zero_fill_cnt;    /* Sectors zeroed on allocation. */
+
+/* Allocates a sector, fills it with the BLOCK_SECTOR_SIZE bytes
+   at DATA, or with zeros if DATA is null, and returns it.
+   Returns 0 if the disk is full. */
+static block_sector_t
+allocate_sector (const void *data)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  block_sector_t sector;
+
+  if (!free_map_allocate (1, &sector))
+    return 0;
+  cache_write_at (sector, data != NULL ? data : zeros, 0, BLOCK_SECTOR_SIZE);
+  alloc_cnt++;
+  if (data == NULL)
+    zero_fill_cnt++;
+  return sector;
+}
+
+/* Returns the sector that *SLOT, a pointer within INODE's
+   on-disk inode, refers to.  If it is a hole and CREATE is
+   true, first allocates a sector for it, filled as by
+   allocate_sector (DATA).
+   Returns 0 for a hole, or if allocation fails. */
+static block_sector_t
+inode_slot (struct inode *inode, block_sector_t *slot, bool create,
+            const void *data)
+{
+  if (*slot == 0 && create)
+    {
+      *slot = allocate_sector (data);
+      if (*slot != 0)
+        cache_write_at (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+    }
+  return *slot;
+}
+
+/* Returns pointer IDX of indirect block TABLE.  If it is a
+   hole and CREATE is true, first allocates a sector for it,
+   filled as by allocate_sector (DATA).
+   Returns 0 for a hole, or if allocation fails. */
+static block_sector_t
+indirect_slot (block_sector_t table, size_t idx, bool create,
+               const void *data)
+{
+  block_sector_t sector;
+
+  ASSERT (idx < PTRS_PER_SECTOR);
+
+  cache_read_at (table, &sector, idx * sizeof sector, sizeof sector);
+  if (sector == 0 && create)
+    {
+      sector = allocate_sector (data);
+      if (sector != 0)
+        cache_write_at (table, &sector, idx * sizeof sector, sizeof sector);
+    }
+  return sector;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   Returns 0 if POS lies in a hole or is beyond the largest
+   possible file.
+
+   Lookups need no locking: a pointer changes only from 0 to its
+   final value, and the sector it points to is filled in before
+   that. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
-    return -1;
+  ASSERT (pos >= 0);
+
+  return lookup_sector (inode, pos, false, NULL);
+}
+
+/* Like byte_to_sector(), but if no sector has been allocated for
+   POS yet, allocates one, along with any indirect blocks needed
+   to reach it.  Indirect blocks are zeroed.  The data sector is
+   filled with the BLOCK_SECTOR_SIZE bytes at DATA, in which case
+   *FILLED is set to true so that the caller need not write them
+   again, or zeroed if DATA is null.
+   Returns 0 if POS is beyond the largest possible file or if
+   allocation fails. */
+static block_sector_t
+byte_to_sector_alloc (struct inode *inode, off_t pos, const void *data,
+                      bool *filled) 
+{
+  block_sector_t sector;
+
+  ASSERT (inode != NULL);
+  ASSERT (pos >= 0);
+
+  *filled = false;
+
+  /* Look without the lock first, since most writes go to
+     sectors that already exist. */
+  sector = lookup_sector (inode, pos, false, NULL);
+  if (sector == 0)
+    {
+      lock_acquire (&inode->lock);
+      sector = lookup_sector (inode, pos, false, NULL);
+      if (sector == 0)
+        {
+          sector = lookup_sector (inode, pos, true, data);
+          *filled = sector != 0 && data != NULL;
+        }
+      lock_release (&inode->lock);
+    }
+  return sector;
+}
+
+/* Does the work of byte_to_sector() and byte_to_sector_alloc().
+   If CREATE is true, allocates missing sectors, filling the data
+   sector as by allocate_sector (DATA), and the caller must hold
+   INODE's LOCK. */
+static block_sector_t
+lookup_sector (struct inode *inode, off_t pos, bool create,
+               const void *data)
+{
+  struct inode_disk *d;
+  size_t idx;
+  block_sector_t table;
+
+  ASSERT (!create || lock_held_by_current_thread (&inode->lock));
+
+  d = &inode->data;
+  idx = pos / BLOCK_SECTOR_SIZE;
+  if (idx < DIRECT_CNT)
+    return inode_slot (inode, &d->direct[idx], create, data);
+
+  idx -= DIRECT_CNT;
+  if (idx < PTRS_PER_SECTOR)
+    {
+      table = inode_slot (inode, &d->indirect, create, NULL);
+      return table != 0 ? indirect_slot (table, idx, create, data) : 0;
+    }
+
+  idx -= PTRS_PER_SECTOR;
+  if (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+    {
+      table = inode_slot (inode, &d->doubly_indirect, create, NULL);
+      if (table != 0)
+        table = indirect_slot (table, idx / PTRS_PER_SECTOR, create, NULL);
+      return table != 0 ? indirect_slot (table, idx % PTRS_PER_SECTOR,
+                                         create, data) : 0;
+    }
+
+  return 0;
+}
+
+/* Releases SECTOR, which is an indirect block if LEVEL is 1 or
+   a doubly indirect block if LEVEL is 2, along with every
+   allocated sector it points to.  Does nothing if SECTOR is 0. */
+static void
+release_sectors (block_sector_t sector, int level)
+{
+  if (sector == 0)
+    return;
+
+  if (level > 0)
+    {
+      size_t i;
+
+      for (i = 0; i < PTRS_PER_SECTOR; i++)
+        release_sectors (indirect_slot (sector, i, false, NULL), level - 1);
+    }
+  free_map_release (sector, 1);
 }
 
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
+static struct lock open_inodes_lock;
+
+/* In-memory inodes. */
+static struct kmem_cache *inode_cache;
+
+/* Initializes the locks of in-memory inode INODE_, which are
+   all released by the time it is closed. */
+static void
+inode_ctor (void *inode_) 
+{
+  struct inode *inode = inode_;
+
+  rwlock_init (&inode->rw);
+  lock_init (&inode->lock);
+  lock_init (&inode->dir_lock);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode),
+                                   inode_ctor);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  No data sectors are allocated until they are
+   written; until then the file reads as zeros.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
+   Returns false if memory allocation fails or LENGTH is larger
+   than the largest possible file. */
 bool
 inode_create (block_sector_t sector, off_t length)
 {
@@ -81,25 +294,16 @@ inode_create (block_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+  if (length > INODE_MAX_LENGTH)
+    return false;
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
+      cache_write_at (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      success = true; 
       free (disk_inode);
     }
   return success;
@@ -114,6 +318,8 @@ inode_open (block_sector_t sector)
   struct list_elem *e;
   struct inode *inode;
 
+  lock_acquire (&open_inodes_lock);
+
   /* Check whether this inode is already open. */
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e)) 
@@ -121,23 +327,30 @@ inode_open (block_sector_t sector)
       inode = list_entry (e, struct inode, elem);
       if (inode->sector == sector) 
         {
-          inode_reopen (inode);
+          inode->open_cnt++;
+          lock_release (&open_inodes_lock);
           return inode; 
         }
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The on-disk inode is read before the new inode
+     is published, so nobody sees it half-filled. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->read_end = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  cache_read_at (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  list_push_front (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +359,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -168,21 +385,29 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
+  lock_acquire (&open_inodes_lock);
   if (--inode->open_cnt == 0)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
+      lock_release (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          size_t i;
+
+          for (i = 0; i < DIRECT_CNT; i++)
+            release_sectors (inode->data.direct[i], 0);
+          release_sectors (inode->data.indirect, 1);
+          release_sectors (inode->data.doubly_indirect, 2);
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
+  else
+    lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -194,6 +419,43 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Most sectors read_direct() reads in one request. */
+#define DIRECT_MAX_SECTORS 64
+
+/* Reads whole sectors of INODE, starting at OFFSET, which must
+   be sector-aligned, straight from disk into BUFFER with a single
+   request, skipping the buffer cache.  Reads as many sectors as
+   are consecutive on disk, not cached, and within both the SIZE
+   bytes requested and the file.  Returns the number of bytes
+   read, or 0 if fewer than two sectors qualify, in which case the
+   caller should go through the cache. */
+static off_t
+read_direct (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  block_sector_t first = byte_to_sector (inode, offset);
+  off_t inode_left = inode_length (inode) - offset;
+  size_t max_cnt, cnt;
+
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+
+  max_cnt = (size < inode_left ? size : inode_left) / BLOCK_SECTOR_SIZE;
+  if (max_cnt > DIRECT_MAX_SECTORS)
+    max_cnt = DIRECT_MAX_SECTORS;
+  if (first == 0 || max_cnt < 2)
+    return 0;
+
+  for (cnt = 0; cnt < max_cnt; cnt++)
+    if (byte_to_sector (inode, offset + cnt * BLOCK_SECTOR_SIZE)
+        != first + cnt
+        || cache_contains (first + cnt))
+      break;
+  if (cnt < 2)
+    return 0;
+
+  block_read_multiple (fs_device, first, cnt, buffer);
+  return cnt * BLOCK_SECTOR_SIZE;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -202,14 +464,31 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  bool sequential = offset == inode->read_end;
 
+  rwlock_acquire_read (&inode->rw);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
+      /* Runs of uncached sectors that lie together on disk are read
+         into BUFFER directly, in one request. */
+      if (sector_ofs == 0)
+        {
+          off_t direct = read_direct (inode, buffer + bytes_read,
+                                      size, offset);
+          if (direct > 0)
+            {
+              size -= direct;
+              offset += direct;
+              bytes_read += direct;
+              continue;
+            }
+        }
+      sector_idx = byte_to_sector (inode, offset);
+
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
       off_t inode_left = inode_length (inode) - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
@@ -220,59 +499,71 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* Holes read as zeros. */
+      if (sector_idx != 0)
+        cache_read_at (sector_idx, buffer + bytes_read,
+                       sector_ofs, chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+
+  /* If this read continued where the last one ended, start
+     fetching the sector that the next one will need. */
+  if (sequential && bytes_read > 0)
+    {
+      off_t next_ofs = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+      if (next_ofs < inode_length (inode))
+        {
+          block_sector_t next = byte_to_sector (inode, next_ofs);
+          if (next != 0)
+            cache_readahead (next);
+        }
+    }
+  inode->read_end = offset;
+  rwlock_release_read (&inode->rw);
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up, the file reaches its
+   maximum size, or an error occurs.  Writing past end of file
+   extends the inode; any gap between the old end of file and
+   OFFSET becomes a hole. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  bool extend;
 
-  if (inode->deny_write_cnt)
-    return 0;
+  /* Writes within the file share the inode with readers and
+     with each other.  Extending the file takes it exclusively. */
+  extend = offset + size > inode_length (inode);
+  if (extend)
+    rwlock_acquire_write (&inode->rw);
+  else
+    rwlock_acquire_read (&inode->rw);
+  if (inode->deny_write_cnt > 0)
+    size = 0;
 
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx;
+      bool filled;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left before the maximum file size, bytes left in
+         sector, lesser of the two. */
+      off_t inode_left = INODE_MAX_LENGTH - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -281,49 +572,53 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /* A new sector that this chunk covers entirely is filled
+         with the chunk as it is allocated, instead of with
+         zeros that would be overwritten right away. */
+      sector_idx = byte_to_sector_alloc (inode, offset,
+                                         (chunk_size == BLOCK_SECTOR_SIZE
+                                          ? buffer + bytes_written : NULL),
+                                         &filled);
+      if (sector_idx == 0)
+        break;
+      if (!filled)
+        cache_write_at (sector_idx, buffer + bytes_written,
+                        sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  /* Extend the file. */
+  if (extend)
+    {
+      if (bytes_written > 0 && offset > inode->data.length)
+        {
+          lock_acquire (&inode->lock);
+          inode->data.length = offset;
+          cache_write_at (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+          lock_release (&inode->lock);
+        }
+      rwlock_release_write (&inode->rw);
+    }
+  else
+    rwlock_release_read (&inode->rw);
 
   return bytes_written;
 }
 
-/* Disables writes to INODE.
+/* Disables writes to INODE, first waiting for any writes in
+   progress to finish.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +627,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_release_write (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +640,28 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Prints sector allocation statistics. */
+void
+inode_print_stats (void)
+{
+  printf ("Inode sectors: %llu allocated, %llu zero-filled\n",
+          alloc_cnt, zero_fill_cnt);
+}
+
+/* Acquires INODE's directory lock, which the directory code
+   holds across each lookup or update of the directory stored in
+   INODE, so that operations on one directory are serialized
+   without affecting any other. */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->dir_lock);
+}
+
+/* Releases INODE's directory lock. */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->dir_lock);
+}
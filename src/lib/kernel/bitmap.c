@@ -27,6 +27,7 @@ typedef unsigned long elem_type;
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
+    size_t next_fit;    /* Where bitmap_scan_and_flip_next() starts. */
     elem_type *bits;    /* Elements that represent bits. */
   };
 
@@ -68,6 +69,38 @@ last_mask (const struct bitmap *b)
   int last_bits = b->bit_cnt % ELEM_BITS;
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's size if there is none.
+
+   Looks at a whole element at a time, skipping elements with no
+   bit set to VALUE, and uses find-first-set (`bsf') to locate
+   the bit within the element that has one. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value) 
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t last_elem = elem_cnt (b->bit_cnt);
+  size_t idx = elem_idx (start);
+  elem_type bits;
+  size_t bit_idx;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  /* Ignore the bits before START in its element. */
+  bits = (b->bits[idx] ^ flip) & ~(bit_mask (start) - 1);
+  while (bits == 0)
+    {
+      if (++idx >= last_elem)
+        return b->bit_cnt;
+      bits = b->bits[idx] ^ flip;
+    }
+
+  /* Unused bits in the last element may look set. */
+  bit_idx = idx * ELEM_BITS + __builtin_ctzl (bits);
+  return bit_idx < b->bit_cnt ? bit_idx : b->bit_cnt;
+}
 
 /* Creation and destruction. */
 
@@ -82,6 +115,7 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->next_fit = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -104,6 +138,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->next_fit = 0;
   b->bits = (elem_type *) (b + 1);
   bitmap_set_all (b, false);
   return b;
@@ -250,16 +285,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && next_bit (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -295,16 +325,27 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t i;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt == 0)
+    return start;
+
+  /* Hop from the start of each run of bits set to VALUE to its
+     end, rather than trying every index. */
+  for (i = start; cnt <= b->bit_cnt - i; )
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t run_start = next_bit (b, i, value);
+      size_t run_end;
+
+      if (cnt > b->bit_cnt - run_start)
+        break;
+      run_end = next_bit (b, run_start, !value);
+      if (run_end - run_start >= cnt)
+        return run_start;
+      i = run_end;
     }
   return BITMAP_ERROR;
 }
@@ -324,6 +365,29 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Like bitmap_scan_and_flip(), but starts from where the group
+   found by the previous call ended, wrapping around to the
+   start of B if there is no group after that.  Repeated calls
+   thus hand out groups in order without rescanning the groups
+   handed out before.  Not atomic either. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t idx;
+
+  ASSERT (b != NULL);
+
+  idx = bitmap_scan (b, b->next_fit, cnt, value);
+  if (idx == BITMAP_ERROR && b->next_fit > 0)
+    idx = bitmap_scan (b, 0, cnt, value);
+  if (idx != BITMAP_ERROR) 
+    {
+      bitmap_set_multiple (b, idx, cnt, !value);
+      b->next_fit = idx + cnt;
+    }
+  return idx;
+}
 
 /* File input and output. */
 
@@ -358,6 +422,26 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes to FILE only the part of B that holds the CNT bits
+   starting at START, at the same offset where bitmap_write()
+   puts it.  Return true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+
+  if (cnt == 0)
+    return true;
+  ofs = elem_idx (start) * sizeof (elem_type);
+  size = byte_cnt (start + cnt) - ofs;
+  return file_write_at (file, (uint8_t *) b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -1,8 +1,35 @@
 #include <string.h>
 #include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The block functions below work a 32-bit word at a time once
+   the destination is word-aligned, and hand large blocks to the
+   CPU's string instructions, which move a word per iteration
+   without loop overhead.  Small blocks, and the ragged bytes at
+   either end, are still handled a byte at a time. */
+
+/* Bytes in a word. */
+#define WORD_SIZE sizeof (uint32_t)
+
+/* Blocks smaller than this are handled a byte at a time. */
+#define WORD_MIN 16
+
+/* Blocks at least this large use string instructions. */
+#define REP_MIN 128
+
+/* True if P is word-aligned. */
+#define WORD_ALIGNED(P) (((uintptr_t) (P) & (WORD_SIZE - 1)) == 0)
+
+/* True if A and B are equally far from word alignment, so that
+   aligning one aligns the other. */
+#define SAME_ALIGN(A, B) \
+        ((((uintptr_t) (A) ^ (uintptr_t) (B)) & (WORD_SIZE - 1)) == 0)
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
-   Returns DST. */
+   Returns DST.
+
+   Copies front to back, which memmove() relies on. */
 void *
 memcpy (void *dst_, const void *src_, size_t size) 
 {
@@ -12,6 +39,34 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
+  /* Misaligned word loads are slow, but less so than bytes for
+     blocks large enough for `rep movsl'. */
+  if (size >= WORD_MIN && (size >= REP_MIN || SAME_ALIGN (dst, src)))
+    {
+      bool rep = size >= REP_MIN;
+      size_t words;
+
+      while (!WORD_ALIGNED (dst))
+        {
+          *dst++ = *src++;
+          size--;
+        }
+      words = size / WORD_SIZE;
+      size %= WORD_SIZE;
+
+      if (rep)
+        asm volatile ("rep movsl"
+                      : "+D" (dst), "+S" (src), "+c" (words)
+                      : : "memory");
+      else
+        for (; words > 0; words--)
+          {
+            *(uint32_t *) dst = *(const uint32_t *) src;
+            dst += WORD_SIZE;
+            src += WORD_SIZE;
+          }
+    }
+
   while (size-- > 0)
     *dst++ = *src++;
 
@@ -29,20 +84,31 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
+  /* Copying front to back is safe unless DST starts inside
+     SRC. */
+  if (dst <= src || dst >= src + size)
+    return memcpy (dst_, src_, size);
+
+  dst += size;
+  src += size;
+  if (size >= WORD_MIN && SAME_ALIGN (dst, src))
     {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
+      while (!WORD_ALIGNED (dst))
+        {
+          *--dst = *--src;
+          size--;
+        }
+      for (; size >= WORD_SIZE; size -= WORD_SIZE)
+        {
+          dst -= WORD_SIZE;
+          src -= WORD_SIZE;
+          *(uint32_t *) dst = *(const uint32_t *) src;
+        }
     }
+  while (size-- > 0)
+    *--dst = *--src;
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +124,19 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip equal words, leaving the first differing one, if any,
+     to the byte loop. */
+  if (size >= WORD_MIN && SAME_ALIGN (a, b))
+    {
+      for (; !WORD_ALIGNED (a); a++, b++, size--)
+        if (*a != *b)
+          return *a > *b ? +1 : -1;
+      for (; size >= WORD_SIZE; a += WORD_SIZE, b += WORD_SIZE,
+                                size -= WORD_SIZE)
+        if (*(const uint32_t *) a != *(const uint32_t *) b)
+          break;
+    }
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -281,6 +360,33 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
+
+  if (size >= WORD_MIN)
+    {
+      uint32_t word = (unsigned char) value * 0x01010101u;
+      bool rep = size >= REP_MIN;
+      size_t words;
+
+      while (!WORD_ALIGNED (dst))
+        {
+          *dst++ = value;
+          size--;
+        }
+      words = size / WORD_SIZE;
+      size %= WORD_SIZE;
+
+      if (rep)
+        asm volatile ("rep stosl"
+                      : "+D" (dst), "+c" (words)
+                      : "a" (word)
+                      : "memory");
+      else
+        for (; words > 0; words--)
+          {
+            *(uint32_t *) dst = word;
+            dst += WORD_SIZE;
+          }
+    }
   
   while (size-- > 0)
     *dst++ = value;
@@ -0,0 +1,47 @@
+/* Child process for syn-read-tput test.
+   Reads one of the test files from start to end PASS_CNT times,
+   CHUNK_SIZE bytes at a time, and verifies its contents. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-read-tput.h"
+
+static char expected[FILE_SIZE];
+static char buf[CHUNK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char name[16];
+  int child_idx;
+  int pass;
+
+  test_name = "child-syn-tput";
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  tput_file_name (child_idx % FILE_CNT, name);
+  tput_file_contents (child_idx % FILE_CNT, expected);
+
+  for (pass = 0; pass < PASS_CNT; pass++) 
+    {
+      size_t ofs;
+      int fd;
+
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE) 
+        {
+          CHECK (read (fd, buf, CHUNK_SIZE) == CHUNK_SIZE,
+                 "read \"%s\" at offset %zu", name, ofs);
+          compare_bytes (buf, expected + ofs, CHUNK_SIZE, ofs, name);
+        }
+      close (fd);
+    }
+
+  return child_idx;
+}
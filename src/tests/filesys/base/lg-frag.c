@@ -0,0 +1,109 @@
+/* Fragments the file system by filling it with small files and
+   deleting every other one, which leaves free space only in
+   short runs, then creates a file larger than any of those
+   runs, writes it, and reads it back.  A file system that
+   needs contiguous sectors for a file cannot do this.
+
+   Every write here covers whole sectors, so the file system
+   should fill the data sectors it allocates with the data
+   written instead of zeroing them first.  lg-frag.ck checks
+   this against the "Inode sectors" line of the kernel's
+   shutdown statistics. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SMALL_SIZE 4096         /* Size of each small file. */
+#define SMALL_MAX 1024          /* Maximum number of small files. */
+#define BIG_SIZE (512 * 1024)   /* Size of the big file. */
+
+static char buf[SMALL_SIZE];
+static char buf2[SMALL_SIZE];
+
+/* Fills BUF with a pattern that depends on IDX. */
+static void
+fill (char *buf_, size_t idx) 
+{
+  size_t i;
+
+  for (i = 0; i < SMALL_SIZE; i++)
+    buf_[i] = idx * 7 + i;
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  size_t small_cnt;
+  size_t i;
+  int fd;
+
+  msg ("filling the disk with %d-byte files", SMALL_SIZE);
+  quiet = true;
+  for (small_cnt = 0; small_cnt < SMALL_MAX; small_cnt++)
+    {
+      bool full;
+
+      snprintf (name, sizeof name, "small%zu", small_cnt);
+      if (!create (name, 0))
+        break;
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      fill (buf, small_cnt);
+      full = write (fd, buf, SMALL_SIZE) != SMALL_SIZE;
+      close (fd);
+      if (full)
+        {
+          CHECK (remove (name), "remove \"%s\"", name);
+          break;
+        }
+    }
+  quiet = false;
+  CHECK (small_cnt >= 2 * BIG_SIZE / SMALL_SIZE,
+         "created enough small files to fill the disk");
+
+  msg ("removing every other file");
+  quiet = true;
+  for (i = 0; i < small_cnt; i += 2)
+    {
+      snprintf (name, sizeof name, "small%zu", i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((fd = open ("big")) > 1, "open \"big\"");
+  msg ("writing %d bytes to \"big\"", BIG_SIZE);
+  for (i = 0; i < BIG_SIZE / SMALL_SIZE; i++)
+    {
+      fill (buf, i);
+      if (write (fd, buf, SMALL_SIZE) != SMALL_SIZE)
+        fail ("write %zu bytes at offset %zu in \"big\" failed",
+              (size_t) SMALL_SIZE, i * SMALL_SIZE);
+    }
+
+  msg ("reading \"big\" back");
+  seek (fd, 0);
+  for (i = 0; i < BIG_SIZE / SMALL_SIZE; i++)
+    {
+      fill (buf, i);
+      if (read (fd, buf2, SMALL_SIZE) != SMALL_SIZE)
+        fail ("read %zu bytes at offset %zu in \"big\" failed",
+              (size_t) SMALL_SIZE, i * SMALL_SIZE);
+      compare_bytes (buf2, buf, SMALL_SIZE, i * SMALL_SIZE, "big");
+    }
+  msg ("close \"big\"");
+  close (fd);
+
+  msg ("checking the remaining small files");
+  quiet = true;
+  for (i = 1; i < small_cnt; i += 2)
+    {
+      snprintf (name, sizeof name, "small%zu", i);
+      fill (buf, i);
+      check_file (name, buf, SMALL_SIZE);
+    }
+  quiet = false;
+}
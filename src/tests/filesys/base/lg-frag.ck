@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lg-frag) begin
+(lg-frag) filling the disk with 4096-byte files
+(lg-frag) created enough small files to fill the disk
+(lg-frag) removing every other file
+(lg-frag) create "big"
+(lg-frag) open "big"
+(lg-frag) writing 524288 bytes to "big"
+(lg-frag) reading "big" back
+(lg-frag) close "big"
+(lg-frag) checking the remaining small files
+(lg-frag) end
+EOF
+
+# The data sectors of the small files and of "big" are all
+# written in full, so only index blocks and directory sectors
+# should be zero-filled when allocated, far fewer than the 1024
+# sectors of "big" alone.
+our ($test);
+my ($alloc, $zeroed)
+  = map (/^Inode sectors: (\d+) allocated, (\d+) zero-filled$/,
+         read_text_file ("$test.output"));
+fail "missing \"Inode sectors\" statistics\n" if !defined $zeroed;
+fail "$zeroed of $alloc allocated sectors were zero-filled, "
+  . "expected fewer than 128\n" if $zeroed >= 128;
+pass "$zeroed of $alloc allocated sectors zero-filled";
@@ -0,0 +1,43 @@
+/* Spawns 8 child processes that read FILE_CNT files concurrently,
+   two readers per file, checking that readers of different files
+   and of the same file, which per-inode locking lets proceed in
+   parallel, all see the right data.  User programs cannot read
+   the timer, so this is a functional test only: the kernel's
+   "Timer: # ticks" line at shutdown covers the whole run,
+   including boot and file creation, not just the reads. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/syn-read-tput.h"
+
+static char buf[FILE_SIZE];
+
+#define CHILD_CNT 8
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      char name[16];
+      int fd;
+
+      tput_file_name (i, name);
+      tput_file_contents (i, buf);
+      CHECK (create (name, sizeof buf), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+             "write \"%s\"", name);
+      msg ("close \"%s\"", name);
+      close (fd);
+    }
+
+  exec_children ("child-syn-tput", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
@@ -0,0 +1,41 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-read-tput) begin
+(syn-read-tput) create "data0"
+(syn-read-tput) open "data0"
+(syn-read-tput) write "data0"
+(syn-read-tput) close "data0"
+(syn-read-tput) create "data1"
+(syn-read-tput) open "data1"
+(syn-read-tput) write "data1"
+(syn-read-tput) close "data1"
+(syn-read-tput) create "data2"
+(syn-read-tput) open "data2"
+(syn-read-tput) write "data2"
+(syn-read-tput) close "data2"
+(syn-read-tput) create "data3"
+(syn-read-tput) open "data3"
+(syn-read-tput) write "data3"
+(syn-read-tput) close "data3"
+(syn-read-tput) exec child 1 of 8: "child-syn-tput 0"
+(syn-read-tput) exec child 2 of 8: "child-syn-tput 1"
+(syn-read-tput) exec child 3 of 8: "child-syn-tput 2"
+(syn-read-tput) exec child 4 of 8: "child-syn-tput 3"
+(syn-read-tput) exec child 5 of 8: "child-syn-tput 4"
+(syn-read-tput) exec child 6 of 8: "child-syn-tput 5"
+(syn-read-tput) exec child 7 of 8: "child-syn-tput 6"
+(syn-read-tput) exec child 8 of 8: "child-syn-tput 7"
+(syn-read-tput) wait for child 1 of 8 returned 0 (expected 0)
+(syn-read-tput) wait for child 2 of 8 returned 1 (expected 1)
+(syn-read-tput) wait for child 3 of 8 returned 2 (expected 2)
+(syn-read-tput) wait for child 4 of 8 returned 3 (expected 3)
+(syn-read-tput) wait for child 5 of 8 returned 4 (expected 4)
+(syn-read-tput) wait for child 6 of 8 returned 5 (expected 5)
+(syn-read-tput) wait for child 7 of 8 returned 6 (expected 6)
+(syn-read-tput) wait for child 8 of 8 returned 7 (expected 7)
+(syn-read-tput) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+#ifndef TESTS_FILESYS_BASE_SYN_READ_TPUT_H
+#define TESTS_FILESYS_BASE_SYN_READ_TPUT_H
+
+#define FILE_CNT 4
+#define FILE_SIZE 65536
+#define CHUNK_SIZE 4096
+#define PASS_CNT 4
+
+/* Fills BUF with the contents of test file IDX. */
+static inline void
+tput_file_contents (int idx, char *buf) 
+{
+  random_init (idx);
+  random_bytes (buf, FILE_SIZE);
+}
+
+/* Stores the name of test file IDX in NAME. */
+static inline void
+tput_file_name (int idx, char name[16]) 
+{
+  snprintf (name, 16, "data%d", idx);
+}
+
+#endif /* tests/filesys/base/syn-read-tput.h */
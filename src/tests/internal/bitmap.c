@@ -0,0 +1,191 @@
+/* Test program and microbenchmark for bitmap scanning in
+   lib/kernel/bitmap.c.
+
+   Checks bitmap_scan() and bitmap_contains() against a
+   bit-at-a-time reference on small random bitmaps.  Then times
+   scans of 1M-bit bitmaps at various fill levels, against the
+   reference, and compares first-fit with next-fit allocation of
+   single bits.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <bitmap.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+#include "devices/timer.h"
+
+/* Size of the bitmaps that we benchmark. */
+#define BENCH_BITS (1024 * 1024)
+
+/* Number of bits allocated in the next-fit benchmark. */
+#define ALLOC_CNT 1000
+
+static void check_small (void);
+static void bench_fill (struct bitmap *, int percent, bool prefix);
+static void bench_alloc (struct bitmap *);
+static size_t ref_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool value);
+
+/* Tests and benchmarks bitmap scanning. */
+void
+test (void) 
+{
+  static const int percents[] = {0, 50, 90, 99};
+  struct bitmap *b;
+  size_t i;
+
+  printf ("testing small bitmaps:");
+  check_small ();
+  printf (" done\n");
+
+  b = bitmap_create (BENCH_BITS);
+  ASSERT (b != NULL);
+
+  printf ("cycles per scan of %d bits (library/reference):\n", BENCH_BITS);
+  for (i = 0; i < sizeof percents / sizeof *percents; i++)
+    {
+      bench_fill (b, percents[i], true);
+      bench_fill (b, percents[i], false);
+    }
+  bench_alloc (b);
+
+  bitmap_destroy (b);
+  printf ("bitmap: PASS\n");
+}
+
+/* Compares bitmap_scan() and bitmap_contains() with the
+   reference on random bitmaps of up to 300 bits. */
+static void
+check_small (void) 
+{
+  int iter;
+
+  for (iter = 0; iter < 2000; iter++)
+    {
+      size_t bit_cnt = random_ulong () % 300;
+      unsigned density = random_ulong () % 100;
+      struct bitmap *b = bitmap_create (bit_cnt);
+      size_t i;
+      int query;
+
+      ASSERT (b != NULL);
+      for (i = 0; i < bit_cnt; i++)
+        bitmap_set (b, i, random_ulong () % 100 < density);
+
+      for (query = 0; query < 20; query++)
+        {
+          size_t start = random_ulong () % (bit_cnt + 1);
+          size_t cnt = random_ulong () % 12;
+          bool value = random_ulong () % 2;
+          size_t k;
+          bool contains = false;
+
+          ASSERT (bitmap_scan (b, start, cnt, value)
+                  == ref_scan (b, start, cnt, value));
+          if (start + cnt > bit_cnt)
+            continue;
+          for (k = 0; k < cnt; k++)
+            if (bitmap_test (b, start + k) == value)
+              contains = true;
+          ASSERT (bitmap_contains (b, start, cnt, value) == contains);
+        }
+      bitmap_destroy (b);
+      if (iter % 200 == 0)
+        printf (" %d", iter);
+    }
+}
+
+/* Sets PERCENT percent of B's bits, either all at the start of
+   B if PREFIX is true or scattered at random otherwise, and
+   prints the time to find the first clear bit and the first run
+   of 8 clear bits. */
+static void
+bench_fill (struct bitmap *b, int percent, bool prefix) 
+{
+  static const size_t cnts[] = {1, 8};
+  size_t bit_cnt = bitmap_size (b);
+  size_t i;
+
+  bitmap_set_all (b, false);
+  if (prefix)
+    bitmap_set_multiple (b, 0, bit_cnt / 100 * percent, true);
+  else
+    for (i = 0; i < bit_cnt; i++)
+      if (random_ulong () % 100 < (unsigned) percent)
+        bitmap_mark (b, i);
+
+  printf ("  %2d%% %s:", percent, prefix ? "prefix" : "random");
+  for (i = 0; i < sizeof cnts / sizeof *cnts; i++)
+    {
+      uint64_t start, lib, ref;
+      size_t lib_idx, ref_idx;
+
+      start = timer_read_tsc ();
+      lib_idx = bitmap_scan (b, 0, cnts[i], false);
+      lib = timer_read_tsc () - start;
+
+      start = timer_read_tsc ();
+      ref_idx = ref_scan (b, 0, cnts[i], false);
+      ref = timer_read_tsc () - start;
+
+      ASSERT (lib_idx == ref_idx);
+      printf (" %zu bits %"PRIu64"/%"PRIu64, cnts[i], lib, ref);
+    }
+  printf ("\n");
+}
+
+/* Prints the time to allocate ALLOC_CNT single bits from B, 90%
+   of which is set at the start, by first fit and by next fit. */
+static void
+bench_alloc (struct bitmap *b) 
+{
+  size_t used = bitmap_size (b) / 10 * 9;
+  uint64_t start, first, next;
+  int i;
+
+  bitmap_set_all (b, false);
+  bitmap_set_multiple (b, 0, used, true);
+  start = timer_read_tsc ();
+  for (i = 0; i < ALLOC_CNT; i++)
+    ASSERT (bitmap_scan_and_flip (b, 0, 1, false) == used + i);
+  first = timer_read_tsc () - start;
+
+  bitmap_set_all (b, false);
+  bitmap_set_multiple (b, 0, used, true);
+  start = timer_read_tsc ();
+  for (i = 0; i < ALLOC_CNT; i++)
+    ASSERT (bitmap_scan_and_flip_next (b, 1, false) != BITMAP_ERROR);
+  next = timer_read_tsc () - start;
+
+  printf ("cycles per single-bit allocation at 90%% full: "
+          "first fit %"PRIu64", next fit %"PRIu64"\n",
+          first / ALLOC_CNT, next / ALLOC_CNT);
+}
+
+/* Reference version of bitmap_scan() that tries every starting
+   index and tests one bit at a time. */
+static size_t
+ref_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
+{
+  size_t i;
+
+  if (cnt == 0)
+    return start;
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    {
+      size_t k;
+
+      for (k = 0; k < cnt; k++)
+        if (bitmap_test (b, i + k) != value)
+          break;
+      if (k == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
@@ -0,0 +1,238 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset() and memcmp() against
+   byte-at-a-time reference versions for every combination of
+   source and destination alignment, for a range of sizes, and
+   for overlapping moves in both directions.  Then reports the
+   throughput of each function for a few block sizes, alongside
+   that of the reference version.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+#include "devices/timer.h"
+
+/* Largest block that we check. */
+#define MAX_SIZE 600
+
+/* Size of the test buffers, with room for MAX_SIZE bytes at any
+   alignment plus guard bytes on either side. */
+#define BUF_SIZE (MAX_SIZE + 64)
+
+/* Block size for the throughput benchmark. */
+#define BENCH_SIZE 4096
+
+static unsigned char buf_a[BUF_SIZE], buf_b[BUF_SIZE], buf_r[BUF_SIZE];
+static unsigned char bench_src[BENCH_SIZE], bench_dst[BENCH_SIZE];
+
+/* Keeps benchmarked memcmp() calls from being optimized away. */
+static volatile int sink;
+
+static void check_size (size_t);
+static void verify_same (const unsigned char *, const unsigned char *,
+                         const char *func, size_t size);
+static void bench (size_t size);
+
+static void ref_memcpy (void *, const void *, size_t);
+static void ref_memmove (void *, const void *, size_t);
+static void ref_memset (void *, int, size_t);
+static int ref_memcmp (const void *, const void *, size_t);
+
+/* Tests the block functions. */
+void
+test (void) 
+{
+  size_t size;
+
+  printf ("testing various sizes:");
+  for (size = 0; size <= MAX_SIZE; size = size < 40 ? size + 1 : size + 13)
+    {
+      printf (" %zu", size);
+      check_size (size);
+    }
+  printf (" done\n");
+
+  printf ("throughput, in bytes per 1000 cycles (library/reference):\n");
+  for (size = 16; size <= BENCH_SIZE; size *= 4)
+    bench (size);
+
+  printf ("string: PASS\n");
+}
+
+/* Checks each function on blocks of SIZE bytes at every
+   alignment. */
+static void
+check_size (size_t size) 
+{
+  int src_ofs, dst_ofs, shift;
+
+  for (src_ofs = 0; src_ofs < 8; src_ofs++)
+    for (dst_ofs = 0; dst_ofs < 8; dst_ofs++)
+      {
+        unsigned char *src = buf_a + 32 + src_ofs;
+        unsigned char *dst = buf_b + 32 + dst_ofs;
+        unsigned char *ref = buf_r + 32 + dst_ofs;
+
+        /* memcpy(). */
+        random_bytes (buf_a, BUF_SIZE);
+        random_bytes (buf_b, BUF_SIZE);
+        memcpy (buf_r, buf_b, BUF_SIZE);
+        ASSERT (memcpy (dst, src, size) == dst);
+        ref_memcpy (ref, src, size);
+        verify_same (buf_b, buf_r, "memcpy", size);
+
+        /* memcmp(), on equal blocks and on blocks that differ
+           in one byte. */
+        ASSERT (memcmp (dst, src, size) == 0);
+        if (size > 0)
+          {
+            size_t i = random_ulong () % size;
+            int expect;
+
+            dst[i] ^= 1 + random_ulong () % 255;
+            expect = ref_memcmp (dst, src, size);
+            ASSERT (expect != 0);
+            ASSERT (memcmp (dst, src, size) == expect);
+            ASSERT (memcmp (src, dst, size) == -expect);
+          }
+
+        /* memset(). */
+        memcpy (buf_r, buf_b, BUF_SIZE);
+        ASSERT (memset (dst, src_ofs * 37, size) == dst);
+        ref_memset (ref, src_ofs * 37, size);
+        verify_same (buf_b, buf_r, "memset", size);
+
+        /* memmove(), between overlapping blocks. */
+        for (shift = -9; shift <= 9; shift++)
+          {
+            unsigned char *from = buf_b + 32 + src_ofs;
+            unsigned char *to = buf_b + 32 + dst_ofs + shift;
+
+            random_bytes (buf_b, BUF_SIZE);
+            memcpy (buf_r, buf_b, BUF_SIZE);
+            ASSERT (memmove (to, from, size) == to);
+            ref_memmove (buf_r + (to - buf_b), buf_r + (from - buf_b), size);
+            verify_same (buf_b, buf_r, "memmove", size);
+          }
+      }
+}
+
+/* Verifies that the test buffers ACTUAL and EXPECT, written by
+   FUNC on blocks of SIZE bytes, are identical. */
+static void
+verify_same (const unsigned char *actual, const unsigned char *expect,
+             const char *func, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    if (actual[i] != expect[i])
+      PANIC ("%s of %zu bytes: byte %zu is %02x, expected %02x",
+             func, size, i, actual[i], expect[i]);
+}
+
+/* Prints the throughput of each function and of its reference
+   version on aligned blocks of SIZE bytes. */
+static void
+bench (size_t size) 
+{
+  enum { BYTE_CNT = 1024 * 1024 };
+  int iter_cnt = BYTE_CNT / size;
+  uint64_t lib[4], ref[4], start;
+  int i;
+
+  memset (bench_src, 0x5a, sizeof bench_src);
+  memset (bench_dst, 0x5a, sizeof bench_dst);
+
+#define TIME(SLOT, STMT)                                \
+  do                                                    \
+    {                                                   \
+      start = timer_read_tsc ();                        \
+      for (i = 0; i < iter_cnt; i++)                    \
+        STMT;                                           \
+      SLOT = timer_read_tsc () - start;                 \
+    }                                                   \
+  while (0)
+
+  TIME (lib[0], memcpy (bench_dst, bench_src, size));
+  TIME (ref[0], ref_memcpy (bench_dst, bench_src, size));
+  TIME (lib[1], memmove (bench_dst + 1, bench_dst, size - 1));
+  TIME (ref[1], ref_memmove (bench_dst + 1, bench_dst, size - 1));
+  TIME (lib[2], memset (bench_dst, i, size));
+  TIME (ref[2], ref_memset (bench_dst, i, size));
+  TIME (lib[3], sink += memcmp (bench_dst, bench_src, size));
+  TIME (ref[3], sink += ref_memcmp (bench_dst, bench_src, size));
+#undef TIME
+
+  printf ("  %4zu bytes:", size);
+  for (i = 0; i < 4; i++)
+    {
+      static const char *names[] = {"memcpy", "memmove", "memset",
+                                    "memcmp"};
+      printf (" %s %"PRIu64"/%"PRIu64, names[i],
+              (uint64_t) BYTE_CNT * 1000 / (lib[i] + 1),
+              (uint64_t) BYTE_CNT * 1000 / (ref[i] + 1));
+    }
+  printf ("\n");
+}
+
+/* Reference versions that work a byte at a time.  They are
+   noinline so that the compiler cannot turn them into calls to
+   the functions under test. */
+
+static void __attribute__ ((noinline))
+ref_memcpy (void *dst_, const void *src_, size_t size) 
+{
+  volatile unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+}
+
+static void __attribute__ ((noinline))
+ref_memmove (void *dst_, const void *src_, size_t size) 
+{
+  volatile unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  if (dst_ < src_)
+    while (size-- > 0)
+      *dst++ = *src++;
+  else 
+    {
+      dst += size;
+      src += size;
+      while (size-- > 0)
+        *--dst = *--src;
+    }
+}
+
+static void __attribute__ ((noinline))
+ref_memset (void *dst_, int value, size_t size) 
+{
+  volatile unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+}
+
+static int __attribute__ ((noinline))
+ref_memcmp (const void *a_, const void *b_, size_t size) 
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
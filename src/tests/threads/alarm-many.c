@@ -0,0 +1,92 @@
+/* Puts 1,000 threads to sleep at once, for durations spread
+   over a few hundred ticks, and checks that none of them wakes
+   up early.  Then checks that kernel timers fire once when they
+   expire and not at all when cancelled.
+
+   With this many sleepers the test also makes a good workload
+   for the "longest interrupt" figure in the timer statistics
+   printed at shutdown. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+#define ITER_CNT 3
+
+static thread_func sleeper;
+static timer_func count_fire;
+
+static int early_cnt;                   /* # of early wake-ups. */
+static int running_cnt;                 /* # of sleepers not done. */
+static struct semaphore done;           /* Upped by last sleeper. */
+
+void
+test_alarm_many (void) 
+{
+  struct timer_event fired, cancelled;
+  int fire_cnt = 0, cancel_cnt = 0;
+  int i;
+
+  msg ("Creating %d threads to sleep %d times each.",
+       THREAD_CNT, ITER_CNT);
+
+  early_cnt = 0;
+  running_cnt = THREAD_CNT;
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "%d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, (void *) i);
+    }
+  sema_down (&done);
+  msg ("%d threads woke up early.", early_cnt);
+
+  timer_add (&fired, timer_ticks () + 5, count_fire, &fire_cnt);
+  timer_add (&cancelled, timer_ticks () + 10, count_fire, &cancel_cnt);
+  if (!timer_cancel (&cancelled))
+    fail ("timer_cancel() of a pending timer returned false");
+  timer_sleep (20);
+  if (timer_cancel (&fired))
+    fail ("timer_cancel() of a fired timer returned true");
+  msg ("Fired timer ran %d time(s), cancelled timer %d time(s).",
+       fire_cnt, cancel_cnt);
+}
+
+static void
+sleeper (void *aux) 
+{
+  int i = (int) aux;
+  int64_t duration = i % 300 + 1;
+  enum intr_level old_level;
+  int iter;
+
+  for (iter = 0; iter < ITER_CNT; iter++)
+    {
+      int64_t start = timer_ticks ();
+      timer_sleep (duration);
+      if (timer_elapsed (start) < duration)
+        {
+          old_level = intr_disable ();
+          early_cnt++;
+          intr_set_level (old_level);
+        }
+    }
+
+  old_level = intr_disable ();
+  if (--running_cnt == 0)
+    sema_up (&done);
+  intr_set_level (old_level);
+}
+
+static void
+count_fire (struct timer_event *e UNUSED, void *cnt_) 
+{
+  int *cnt = cnt_;
+  (*cnt)++;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-many) begin
+(alarm-many) Creating 1000 threads to sleep 3 times each.
+(alarm-many) 0 threads woke up early.
+(alarm-many) Fired timer ran 1 time(s), cancelled timer 0 time(s).
+(alarm-many) end
+EOF
+pass;
@@ -0,0 +1,72 @@
+/* Stresses the advanced scheduler with many threads that spend
+   nearly all their time blocked.
+
+   500 threads each sleep for one to two seconds, then spin for
+   a tick, five times over, while the main thread spins the
+   whole time.  With recent_cpu decayed lazily for blocked
+   threads, the work done with interrupts off on each timer tick
+   should not depend on the number of sleepers.
+   mlfqs-block-500.ck checks the longest timer interrupt printed
+   at shutdown against a bound well below what a walk over every
+   thread once a second would cost. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 500
+#define ITER_CNT 5
+
+static thread_func sleeper;
+
+static int running_cnt;                 /* # of sleepers not done. */
+
+void
+test_mlfqs_block_500 (void) 
+{
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  msg ("Starting %d threads that sleep most of the time...", THREAD_CNT);
+  running_cnt = THREAD_CNT;
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, (void *) i);
+    }
+
+  msg ("Main thread spinning until they are done...");
+  while (running_cnt > 0)
+    barrier ();
+
+  msg ("All %d threads are done.", THREAD_CNT);
+}
+
+static void
+sleeper (void *aux) 
+{
+  int i = (int) aux;
+  enum intr_level old_level;
+  int iter;
+
+  for (iter = 0; iter < ITER_CNT; iter++)
+    {
+      int64_t start_time;
+
+      timer_sleep (TIMER_FREQ + i % TIMER_FREQ);
+
+      start_time = timer_ticks ();
+      while (timer_elapsed (start_time) == 0)
+        continue;
+    }
+
+  old_level = intr_disable ();
+  running_cnt--;
+  intr_set_level (old_level);
+}
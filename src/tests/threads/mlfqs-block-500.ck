@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs-block-500) begin
+(mlfqs-block-500) Starting 500 threads that sleep most of the time...
+(mlfqs-block-500) Main thread spinning until they are done...
+(mlfqs-block-500) All 500 threads are done.
+(mlfqs-block-500) end
+EOF
+
+# At 100 cycles or more per thread, decaying recent_cpu for all
+# 500 threads once a second would take at least 50,000 cycles
+# with interrupts off.  Only the running and ready threads should
+# be touched, keeping every timer interrupt well below that.
+our ($test);
+my ($cycles) = map (/longest interrupt (\d+) cycles/,
+                    read_text_file ("$test.output"));
+fail "missing \"longest interrupt\" timer statistic\n"
+  if !defined $cycles;
+fail "longest timer interrupt took $cycles cycles, "
+  . "expected fewer than 25000\n" if $cycles >= 25000;
+pass "longest timer interrupt took $cycles cycles";
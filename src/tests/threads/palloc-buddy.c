@@ -0,0 +1,112 @@
+/* Measures the cost of page allocation with a mix of single and
+   multi-page requests.
+
+   Keeps a set of slots, each either empty or holding a block of
+   pages from palloc_get_multiple().  Each step picks a random
+   slot and frees its block if it has one, or allocates a new
+   block into it if not, until 100,000 blocks have been
+   allocated.  Most blocks are a single page; the rest are 2 to
+   8 pages.  Every block is stamped with its slot
+   number when allocated and checked before it is freed, so that
+   overlapping blocks are caught.  With a buddy allocator the
+   cost of each step does not depend on how fragmented the pool
+   has become. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Number of allocations, not counting frees. */
+#define ALLOC_CNT 100000
+
+/* Number of blocks that may be allocated at once. */
+#define SLOT_CNT 64
+
+/* Largest block, in pages. */
+#define MAX_PAGES 8
+
+struct slot
+  {
+    uint8_t *pages;             /* Allocated block, or NULL. */
+    size_t page_cnt;            /* Pages in block. */
+  };
+
+static void stamp (struct slot *, int idx);
+static void check (struct slot *, int idx);
+
+void
+test_palloc_buddy (void) 
+{
+  static struct slot slots[SLOT_CNT];
+  int64_t start_time, elapsed;
+  int alloc_cnt = 0;
+  int multi_cnt = 0;
+  int free_cnt = 0;
+  int i;
+
+  random_init (0);
+  start_time = timer_ticks ();
+  while (alloc_cnt < ALLOC_CNT) 
+    {
+      int idx = random_ulong () % SLOT_CNT;
+      struct slot *s = &slots[idx];
+
+      if (s->pages != NULL) 
+        {
+          check (s, idx);
+          palloc_free_multiple (s->pages, s->page_cnt);
+          s->pages = NULL;
+          free_cnt++;
+          continue;
+        }
+
+      s->page_cnt = random_ulong () % 4 != 0
+                    ? 1 : 2 + random_ulong () % (MAX_PAGES - 1);
+      s->pages = palloc_get_multiple (0, s->page_cnt);
+      if (s->pages == NULL)
+        fail ("out of pages after %d allocations", alloc_cnt);
+      stamp (s, idx);
+      alloc_cnt++;
+      if (s->page_cnt > 1)
+        multi_cnt++;
+    }
+  elapsed = timer_elapsed (start_time);
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (slots[i].pages != NULL) 
+      {
+        check (&slots[i], i);
+        palloc_free_multiple (slots[i].pages, slots[i].page_cnt);
+        slots[i].pages = NULL;
+      }
+
+  msg ("%d allocations (%d multi-page) and %d frees in %"PRId64" ticks "
+       "(%"PRId64" ns/allocation)",
+       alloc_cnt, multi_cnt, free_cnt, elapsed,
+       elapsed * (1000000000 / TIMER_FREQ) / alloc_cnt);
+}
+
+/* Writes IDX into the first byte of each page in slot S. */
+static void
+stamp (struct slot *s, int idx) 
+{
+  size_t i;
+
+  for (i = 0; i < s->page_cnt; i++)
+    s->pages[i * PGSIZE] = idx;
+}
+
+/* Checks that each page in slot S still holds IDX. */
+static void
+check (struct slot *s, int idx) 
+{
+  size_t i;
+
+  for (i = 0; i < s->page_cnt; i++)
+    if (s->pages[i * PGSIZE] != idx)
+      fail ("page %zu of slot %d overwritten", i, idx);
+}
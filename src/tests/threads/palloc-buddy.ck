@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "missing result\n"
+  if !grep (/^\(palloc-buddy\) 100000 allocations \(\d+ multi-page\) and \d+ frees in \d+ ticks \(\d+ ns\/allocation\)$/, @output);
+pass;
@@ -0,0 +1,51 @@
+/* Checks that pages obtained with PAL_ZERO are zeroed when some
+   of them come from the pool that the idle thread zeroes ahead
+   of time.
+
+   Sleeps so that the idle thread can fill the pool, then
+   allocates more zeroed pages than the pool holds, checks them,
+   scribbles on them, and frees them.  Repeats a few times, so
+   that pages freed dirty are zeroed again before reuse. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Pages allocated per round. */
+#define PAGE_CNT 64
+
+/* Number of rounds. */
+#define ROUND_CNT 4
+
+void
+test_palloc_zero (void) 
+{
+  static uint8_t *pages[PAGE_CNT];
+  int round, i;
+  size_t j;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      /* Give the idle thread time to zero pages. */
+      timer_sleep (10);
+
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          pages[i] = palloc_get_page (PAL_ZERO);
+          if (pages[i] == NULL)
+            fail ("round %d: out of pages", round);
+          for (j = 0; j < PGSIZE; j++)
+            if (pages[i][j] != 0)
+              fail ("round %d: page %d byte %zu is not zero",
+                    round, i, j);
+          memset (pages[i], 0x5a, PGSIZE);
+        }
+
+      for (i = 0; i < PAGE_CNT; i++)
+        palloc_free_page (pages[i]);
+      msg ("round %d: %d zeroed pages", round, PAGE_CNT);
+    }
+}
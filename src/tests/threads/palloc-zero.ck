@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero) begin
+(palloc-zero) round 0: 64 zeroed pages
+(palloc-zero) round 1: 64 zeroed pages
+(palloc-zero) round 2: 64 zeroed pages
+(palloc-zero) round 3: 64 zeroed pages
+(palloc-zero) end
+EOF
+pass;
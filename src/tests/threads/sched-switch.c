@@ -0,0 +1,94 @@
+/* Measures the cost of a context switch as the number of ready
+   threads grows.
+
+   For each of 10, 100, and 1000 threads, creates that many
+   threads at the same priority, each of which yields the CPU
+   over and over, so that every thread_yield() makes the
+   scheduler pick the next thread out of a full run queue.  The
+   total number of switches is the same for each thread count,
+   so with a scheduler whose cost does not depend on the number
+   of ready threads, the reported times should be roughly
+   equal. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Total number of thread_yield() calls per run. */
+#define SWITCH_CNT 100000
+
+struct switch_info
+  {
+    int yield_cnt;              /* Yields per thread. */
+    int running_cnt;            /* Threads not yet done. */
+    struct semaphore done;      /* Upped by the last thread. */
+  };
+
+static void measure (int thread_cnt);
+static thread_func yield_thread;
+
+void
+test_sched_switch (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  measure (10);
+  measure (100);
+  measure (1000);
+}
+
+static void
+measure (int thread_cnt) 
+{
+  struct switch_info info;
+  int64_t start_time, elapsed;
+  int i;
+
+  info.yield_cnt = SWITCH_CNT / thread_cnt;
+  info.running_cnt = thread_cnt;
+  sema_init (&info.done, 0);
+
+  /* Create all the threads before any of them gets to run. */
+  thread_set_priority (PRI_DEFAULT + 1);
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "%d", i);
+      thread_create (name, PRI_DEFAULT, yield_thread, &info);
+    }
+
+  start_time = timer_ticks ();
+  sema_down (&info.done);
+  elapsed = timer_elapsed (start_time);
+  thread_set_priority (PRI_DEFAULT);
+
+  msg ("%d ready threads: %d switches in %"PRId64" ticks "
+       "(%"PRId64" ns/switch)",
+       thread_cnt, info.yield_cnt * thread_cnt, elapsed,
+       elapsed * (1000000000 / TIMER_FREQ) / (info.yield_cnt * thread_cnt));
+}
+
+static void
+yield_thread (void *info_) 
+{
+  struct switch_info *info = info_;
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < info->yield_cnt; i++)
+    thread_yield ();
+
+  old_level = intr_disable ();
+  if (--info->running_cnt == 0)
+    sema_up (&info->done);
+  intr_set_level (old_level);
+}
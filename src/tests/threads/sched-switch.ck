@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+for my $thread_cnt (10, 100, 1000) {
+    fail "missing result for $thread_cnt threads\n"
+      if !grep (/^\(sched-switch\) $thread_cnt ready threads: \d+ switches in \d+ ticks \(\d+ ns\/switch\)$/, @output);
+}
+pass;
@@ -0,0 +1,86 @@
+/* Checks the slab cache allocator.
+
+   Creates a cache of odd-sized objects with a constructor and
+   fills several slabs' worth of them, stamping each one and
+   checking that no stamp is overwritten.  Then frees every
+   object and allocates them again, checking that reused objects
+   come back in their constructed state without the constructor
+   running on all of them again. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+/* Number of objects allocated at once. */
+#define OBJ_CNT 200
+
+struct object
+  {
+    int constructed;            /* Set to CONSTRUCTED by obj_ctor. */
+    int stamp;                  /* Index while allocated. */
+    char pad[45];               /* Makes the size odd. */
+  };
+
+#define CONSTRUCTED 0x5eed
+
+static int ctor_cnt;
+
+static void
+obj_ctor (void *o_) 
+{
+  struct object *o = o_;
+
+  o->constructed = CONSTRUCTED;
+  ctor_cnt++;
+}
+
+void
+test_slab_cache (void) 
+{
+  static struct object *objs[OBJ_CNT];
+  struct kmem_cache *c;
+  int first_ctor_cnt = 0;
+  int pass, i;
+
+  c = kmem_cache_create ("test", sizeof (struct object), obj_ctor);
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      for (i = 0; i < OBJ_CNT; i++) 
+        {
+          objs[i] = kmem_cache_alloc (c);
+          if (objs[i] == NULL)
+            fail ("allocation %d failed", i);
+          if (objs[i]->constructed != CONSTRUCTED)
+            fail ("object %d is not constructed", i);
+          if (pg_round_down (objs[i])
+              != pg_round_down ((char *) (objs[i] + 1) - 1))
+            fail ("object %d crosses a page boundary", i);
+          objs[i]->stamp = i;
+          memset (objs[i]->pad, i, sizeof objs[i]->pad);
+        }
+
+      for (i = 0; i < OBJ_CNT; i++) 
+        if (objs[i]->stamp != i || objs[i]->pad[44] != (char) i)
+          fail ("object %d overwritten", i);
+
+      /* Free every other object first, so that the slabs are
+         partly free for a while. */
+      for (i = 0; i < OBJ_CNT; i += 2)
+        kmem_cache_free (c, objs[i]);
+      for (i = 1; i < OBJ_CNT; i += 2)
+        kmem_cache_free (c, objs[i]);
+
+      msg ("pass %d: allocated and freed %d objects", pass, OBJ_CNT);
+      if (pass == 0)
+        first_ctor_cnt = ctor_cnt;
+    }
+
+  /* Objects in released slabs are constructed again when their
+     slab is carved anew, but the slab kept back is reused. */
+  if (ctor_cnt >= 2 * first_ctor_cnt)
+    fail ("constructor ran for every reused object");
+  msg ("freed objects were reused");
+}
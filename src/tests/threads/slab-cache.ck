@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) pass 0: allocated and freed 200 objects
+(slab-cache) pass 1: allocated and freed 200 objects
+(slab-cache) freed objects were reused
+(slab-cache) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Opens the same file 10,000 times, checking that each open
+   returns the lowest unused file descriptor, that descriptors
+   freed by close are reused lowest first, and that the kernel
+   refuses to exceed the -fd limit the test runs with.
+
+   This is a functional test only.  It does not time the
+   descriptor lookups, since user programs cannot read the
+   timer. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10000
+
+void
+test_main (void) 
+{
+  int fd, i;
+
+  msg ("open \"sample.txt\" %d times", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    if ((fd = open ("sample.txt")) != i + 2)
+      fail ("open #%d returned %d, expected %d", i, fd, i + 2);
+
+  CHECK (open ("sample.txt") == -1, "open beyond the limit fails");
+
+  msg ("close every other file");
+  for (i = 0; i < FILE_CNT; i += 2)
+    close (i + 2);
+
+  msg ("reopen closed descriptors lowest first");
+  for (i = 0; i < FILE_CNT; i += 2)
+    if ((fd = open ("sample.txt")) != i + 2)
+      fail ("reopen returned %d, expected %d", fd, i + 2);
+
+  msg ("read through the last descriptor");
+  {
+    char c;
+    CHECK (read (FILE_CNT + 1, &c, 1) == 1, "read one byte");
+  }
+
+  msg ("close all files");
+  for (i = 0; i < FILE_CNT; i++)
+    close (i + 2);
+
+  CHECK (open ("sample.txt") == 2, "open after closing all returns 2");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) open "sample.txt" 10000 times
+(open-many) open beyond the limit fails
+(open-many) close every other file
+(open-many) reopen closed descriptors lowest first
+(open-many) read through the last descriptor
+(open-many) read one byte
+(open-many) close all files
+(open-many) open after closing all returns 2
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
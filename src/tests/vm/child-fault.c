@@ -0,0 +1,31 @@
+/* Child process of page-fault-seq and page-fault-par.
+   Writes one byte to each page of a 768 kB buffer, then makes
+   two passes reading them back, faulting on nearly every page
+   when memory is short. */
+
+#include "tests/lib.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 192
+#define PASS_CNT 2
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+int
+main (void)
+{
+  size_t i;
+  int pass;
+
+  test_name = "child-fault";
+
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE_SIZE] = i;
+
+  for (pass = 0; pass < PASS_CNT; pass++)
+    for (i = 0; i < PAGE_CNT; i++)
+      if (buf[i * PAGE_SIZE] != (char) i)
+        fail ("page %zu is corrupted", i);
+
+  return 0x42;
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-lat-copy) begin
+(fork-lat-copy) filled heap
+(fork-lat-copy) fork 0
+(fork-lat-copy) wait for child 0
+(fork-lat-copy) fork 1
+(fork-lat-copy) wait for child 1
+(fork-lat-copy) fork 2
+(fork-lat-copy) wait for child 2
+(fork-lat-copy) fork 3
+(fork-lat-copy) wait for child 3
+(fork-lat-copy) heap intact
+(fork-lat-copy) end
+EOF
+pass;
@@ -0,0 +1,65 @@
+/* Fills a 4 MB heap and forks several times.  Each child checks
+   that it sees the parent's heap and then changes part of it,
+   which must not show through to the parent.  The kernel prints
+   how long fork() took on average when it shuts down.  Run as
+   fork-lat, where fork() shares memory copy-on-write, and as
+   fork-lat-copy, where it copies memory right away, to compare
+   the two. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HEAP_SIZE (4 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define FORK_CNT 4
+
+static char heap[HEAP_SIZE];
+
+/* Byte expected at the start of heap page PAGE. */
+static char
+page_value (size_t page)
+{
+  return page * 7 + 1;
+}
+
+/* Runs in the child of fork FORK_IDX. */
+static void
+child (int fork_idx)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < HEAP_SIZE; ofs += PAGE_SIZE)
+    if (heap[ofs] != page_value (ofs / PAGE_SIZE))
+      fail ("child %d: byte %zu is %d", fork_idx, ofs, heap[ofs]);
+
+  /* Write to one page in 16. */
+  for (ofs = 0; ofs < HEAP_SIZE; ofs += 16 * PAGE_SIZE)
+    heap[ofs] = ~heap[ofs];
+  exit (fork_idx);
+}
+
+void
+test_main (void)
+{
+  size_t ofs;
+  int i;
+
+  for (ofs = 0; ofs < HEAP_SIZE; ofs += PAGE_SIZE)
+    heap[ofs] = page_value (ofs / PAGE_SIZE);
+  msg ("filled heap");
+
+  for (i = 0; i < FORK_CNT; i++)
+    {
+      pid_t pid = fork ();
+      if (pid == 0)
+        child (i);
+      CHECK (pid != -1, "fork %d", i);
+      CHECK (wait (pid) == i, "wait for child %d", i);
+    }
+
+  for (ofs = 0; ofs < HEAP_SIZE; ofs += PAGE_SIZE)
+    if (heap[ofs] != page_value (ofs / PAGE_SIZE))
+      fail ("byte %zu is %d", ofs, heap[ofs]);
+  msg ("heap intact");
+}
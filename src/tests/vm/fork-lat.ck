@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-lat) begin
+(fork-lat) filled heap
+(fork-lat) fork 0
+(fork-lat) wait for child 0
+(fork-lat) fork 1
+(fork-lat) wait for child 1
+(fork-lat) fork 2
+(fork-lat) wait for child 2
+(fork-lat) fork 3
+(fork-lat) wait for child 3
+(fork-lat) heap intact
+(fork-lat) end
+EOF
+pass;
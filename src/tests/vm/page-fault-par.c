@@ -0,0 +1,8 @@
+#include "tests/main.h"
+#include "tests/vm/parallel-fault.h"
+
+void
+test_main (void) 
+{
+  parallel_fault (4);
+}
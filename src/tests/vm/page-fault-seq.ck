@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-fault-seq) begin
+(page-fault-seq) exec child 0
+(page-fault-seq) wait for child 0
+(page-fault-seq) exec child 1
+(page-fault-seq) wait for child 1
+(page-fault-seq) exec child 2
+(page-fault-seq) wait for child 2
+(page-fault-seq) exec child 3
+(page-fault-seq) wait for child 3
+(page-fault-seq) end
+EOF
+pass;
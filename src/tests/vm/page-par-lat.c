@@ -0,0 +1,29 @@
+/* Runs 4 child-linear processes at once, several times over, to
+   keep physical memory under steady pressure.  The kernel prints
+   page fault latency percentiles when it shuts down.  Run as
+   page-par-lat with the pageout daemon and as page-par-lat-nopo
+   without it, to compare the two. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+#define ROUND_CNT 3
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < CHILD_CNT; i++) 
+        CHECK ((children[i] = exec ("child-linear")) != -1,
+               "exec \"child-linear\"");
+
+      for (i = 0; i < CHILD_CNT; i++) 
+        CHECK (wait (children[i]) == 0x42, "wait for child %d", i);
+    }
+}
@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-par-lat) begin
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) wait for child 0
+(page-par-lat) wait for child 1
+(page-par-lat) wait for child 2
+(page-par-lat) wait for child 3
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) wait for child 0
+(page-par-lat) wait for child 1
+(page-par-lat) wait for child 2
+(page-par-lat) wait for child 3
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) exec "child-linear"
+(page-par-lat) wait for child 0
+(page-par-lat) wait for child 1
+(page-par-lat) wait for child 2
+(page-par-lat) wait for child 3
+(page-par-lat) end
+EOF
+pass;
@@ -0,0 +1,41 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-share) begin
+(page-share) exec child 0
+(page-share) exec child 1
+(page-share) exec child 2
+(page-share) exec child 3
+(page-share) exec child 4
+(page-share) exec child 5
+(page-share) exec child 6
+(page-share) exec child 7
+(page-share) exec child 8
+(page-share) exec child 9
+(page-share) exec child 10
+(page-share) exec child 11
+(page-share) exec child 12
+(page-share) exec child 13
+(page-share) exec child 14
+(page-share) exec child 15
+(page-share) wait for child 0
+(page-share) wait for child 1
+(page-share) wait for child 2
+(page-share) wait for child 3
+(page-share) wait for child 4
+(page-share) wait for child 5
+(page-share) wait for child 6
+(page-share) wait for child 7
+(page-share) wait for child 8
+(page-share) wait for child 9
+(page-share) wait for child 10
+(page-share) wait for child 11
+(page-share) wait for child 12
+(page-share) wait for child 13
+(page-share) wait for child 14
+(page-share) wait for child 15
+(page-share) end
+EOF
+pass;
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-swap-seq-nora) begin
+(page-swap-seq-nora) write pass
+(page-swap-seq-nora) read pass 0
+(page-swap-seq-nora) read pass 1
+(page-swap-seq-nora) end
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Writes 2 MB of memory in order, which pushes most of it out to
+   swap, then reads it back in order twice, checking it.  The
+   kernel prints how many pages it read ahead from swap, and how
+   many of those were used, when it shuts down.  Run as
+   page-swap-seq with swap readahead and as page-swap-seq-nora
+   without it, to compare the two. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+#define PASS_CNT 2
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+  int pass;
+
+  msg ("write pass");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      msg ("read pass %d", pass);
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != (char) (i % 251))
+          fail ("byte %zu is %d", i, buf[i]);
+    }
+}
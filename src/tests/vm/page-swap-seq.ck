@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-swap-seq) begin
+(page-swap-seq) write pass
+(page-swap-seq) read pass 0
+(page-swap-seq) read pass 1
+(page-swap-seq) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Reads all of an 8 MB array of zeros, more than fits in
+   physical memory, then writes to a few of its pages and checks
+   that only those changed.  Pages that are only read may share
+   one page of zeros, so the kernel need not give them frames of
+   their own; it prints how many frames pages held at most when
+   it shuts down. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (8 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define STRIDE (64 * PAGE_SIZE)
+
+static char buf[SIZE];
+
+/* Checks that BUF holds zeros except for the first byte of every
+   STRIDE bytes if WRITTEN is true. */
+static void
+check (bool written)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    {
+      char expected = written && i % STRIDE == 0 ? (char) (i / STRIDE + 1) : 0;
+      if (buf[i] != expected)
+        fail ("byte %zu is %d, not %d", i, buf[i], expected);
+    }
+}
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read pass");
+  check (false);
+
+  msg ("write pass");
+  for (i = 0; i < SIZE; i += STRIDE)
+    buf[i] = i / STRIDE + 1;
+
+  msg ("read pass");
+  check (true);
+}
@@ -0,0 +1,30 @@
+/* Runs CHILD_CNT child-fault processes, CONCURRENCY of them at a
+   time.  Each child touches more memory than the kernel lets
+   user processes have, so all of them keep page faulting and
+   evicting frames.  Comparing the run time of page-fault-seq,
+   which runs one child at a time, with that of page-fault-par,
+   which runs them all at once, shows how well page fault
+   handling overlaps across processes. */
+
+#include "tests/vm/parallel-fault.h"
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+parallel_fault (int concurrency) 
+{
+  pid_t children[CHILD_CNT];
+  int i, j;
+
+  for (i = 0; i < CHILD_CNT; i += concurrency)
+    {
+      for (j = i; j < i + concurrency && j < CHILD_CNT; j++)
+        CHECK ((children[j] = exec ("child-fault")) != -1,
+               "exec child %d", j);
+      for (j = i; j < i + concurrency && j < CHILD_CNT; j++)
+        CHECK (wait (children[j]) == 0x42, "wait for child %d", j);
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef TESTS_VM_PARALLEL_FAULT
+#define TESTS_VM_PARALLEL_FAULT 1
+
+void parallel_fault (int concurrency);
+
+#endif /* tests/vm/parallel-fault.h */
@@ -39,7 +39,9 @@
 #endif
 #ifdef VM
 #include "vm/frame.h"
+#include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/zswap.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -134,6 +136,7 @@ main (void)
 #ifdef VM
   /* Initialize virtual memory system. */
   frame_init ();
+  page_init ();
   swap_init ();
 #endif
 
@@ -260,6 +263,24 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-no-pageout"))
+        pageout_enabled = false;
+      else if (!strcmp (name, "-fork-copy"))
+        fork_cow = false;
+      else if (!strcmp (name, "-zswap"))
+        {
+          int pages = atoi (value);
+          if (pages < 0)
+            PANIC ("-zswap=%s: page count must not be negative", value);
+          zswap_limit = pages;
+        }
+      else if (!strcmp (name, "-swap-ra"))
+        {
+          int pages = atoi (value);
+          swap_readahead = (pages < 0 ? 0
+                            : pages < SWAP_READ_MAX ? pages
+                            : SWAP_READ_MAX - 1);
+        }
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -269,6 +290,13 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-fd"))
+        {
+          int limit = atoi (value);
+          if (limit < 3)
+            PANIC ("-fd=%s: limit must be at least 3", value);
+          fd_limit = limit;
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -385,12 +413,18 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -no-pageout        Evict frames only when page faults need them.\n"
+          "  -fork-copy         Copy all memory on fork instead of on write.\n"
+          "  -swap-ra=PAGES     Read up to PAGES extra pages per swap fault.\n"
+          "  -zswap=PAGES       Compress swapped pages into up to PAGES pages\n"
+          "                     of kernel memory before using the swap disk.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -fd=MAX            Limit processes to file descriptors below MAX.\n"
 #endif
           );
   shutdown_power_off ();
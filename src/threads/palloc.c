@@ -2,14 +2,16 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/interrupt.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -23,13 +25,50 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Its free pages
+   are grouped into blocks of 2**ORDER pages, for ORDER up to
+   MAX_ORDER, whose index within the pool is a multiple of their
+   size.  There is a list of free blocks of each order, linked
+   through list_elems kept in the free pages themselves.  A
+   request for N pages takes a block of the smallest order that
+   holds N pages, splitting larger blocks as needed, and gives
+   back the pages beyond N.  Freed pages are merged with their
+   free buddies into ever larger blocks.  A request for more
+   than 2**MAX_ORDER pages instead takes a run of free blocks of
+   order MAX_ORDER that lie next to each other, found by a
+   linear scan.
+
+   The free lists are protected by disabling interrupts rather
+   than by a lock, because a dying thread's page is freed from
+   within the scheduler.  Each operation touches only O(log n)
+   blocks, so interrupts are off only briefly.
+
+   Each pool also keeps a few pages that the idle thread has
+   zeroed ahead of time, so that requests for a zeroed page need
+   not zero one on the spot.  These pages count as allocated.
+   When a pool otherwise runs out, they are given back to it. */
+
+/* Largest block order. */
+#define MAX_ORDER 10
+
+/* ORDER_MAP entry for the first page of a free block, combined
+   with the block's order.  Every other page's entry is 0. */
+#define FREE_BLOCK 0x80
+
+/* Number of pre-zeroed pages kept per pool. */
+#define ZEROED_MAX 16
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *order_map;                 /* Free block info per page. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks by order. */
+    void *zeroed[ZEROED_MAX];           /* Pre-zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pre-zeroed pages. */
+    size_t free_cnt;                    /* Number of free pages. */
     uint8_t *base;                      /* Base of pool. */
   };
 
@@ -39,6 +78,17 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static size_t alloc_large (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static bool release_zeroed (struct pool *);
+
+/* Pre-zeroed page statistics. */
+static unsigned long long zeroed_hit_cnt;   /* Requests served zeroed. */
+static unsigned long long zeroed_miss_cnt;  /* Requests zeroed on the spot. */
+static unsigned long long idle_zero_cnt;    /* Pages zeroed when idle. */
+static unsigned long long idle_zero_cycles; /* Cycles spent doing so. */
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -73,13 +123,23 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
   size_t page_idx;
+  enum intr_level old_level;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  if (page_cnt == 1 && (flags & PAL_ZERO))
+    {
+      pages = take_zeroed (pool);
+      if (pages != NULL)
+        return pages;
+    }
+
+  old_level = intr_disable ();
+  page_idx = alloc_pages (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && release_zeroed (pool))
+    page_idx = alloc_pages (pool, page_cnt);
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -119,6 +179,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +198,9 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  free_pages (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +210,107 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Obtains a page that the idle thread has already zeroed and
+   returns its kernel virtual address, or returns a null pointer
+   if none is ready.  Takes it from the user pool if PAL_USER is
+   set in FLAGS.  The caller must zero a page itself on failure,
+   but may choose to do so without holding locks that
+   palloc_get_page (PAL_ZERO) would be called under. */
+void *
+palloc_get_zeroed_page (enum palloc_flags flags) 
+{
+  return take_zeroed (flags & PAL_USER ? &user_pool : &kernel_pool);
+}
+
+/* Called by the idle thread to zero free pages ahead of time,
+   until each pool has ZEROED_MAX of them or runs out of free
+   pages.  Pages are zeroed with interrupts on, so the idle
+   thread gives way to any thread that becomes ready. */
+void
+palloc_zero_idle (void) 
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+
+      for (;;)
+        {
+          enum intr_level old_level;
+          size_t page_idx;
+          uint8_t *page;
+          uint64_t start;
+
+          old_level = intr_disable ();
+          page_idx = pool->zeroed_cnt < ZEROED_MAX
+                     ? alloc_pages (pool, 1) : BITMAP_ERROR;
+          intr_set_level (old_level);
+          if (page_idx == BITMAP_ERROR)
+            break;
+
+          page = pool->base + PGSIZE * page_idx;
+          start = timer_read_tsc ();
+          memset (page, 0, PGSIZE);
+
+          old_level = intr_disable ();
+          idle_zero_cycles += timer_read_tsc () - start;
+          idle_zero_cnt++;
+          if (pool->zeroed_cnt < ZEROED_MAX)
+            pool->zeroed[pool->zeroed_cnt++] = page;
+          else
+            free_pages (pool, page_idx, 1);
+          intr_set_level (old_level);
+        }
+    }
+}
+
+/* Returns the number of pages that can currently be allocated,
+   one at a time, from the user pool if PAL_USER is set in FLAGS
+   or from the kernel pool otherwise.  This includes the
+   pre-zeroed pages.  The count may be out of date by the time
+   the caller looks at it. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  size_t cnt;
+
+  old_level = intr_disable ();
+  cnt = pool->free_cnt + pool->zeroed_cnt;
+  intr_set_level (old_level);
+  return cnt;
+}
+
+/* Prints pre-zeroed page statistics. */
+void
+palloc_print_stats (void) 
+{
+  unsigned long long avg_cycles
+    = idle_zero_cnt > 0 ? idle_zero_cycles / idle_zero_cnt : 0;
+
+  printf ("Pre-zeroed pages: %llu hits, %llu misses, "
+          "%llu zeroed when idle at %llu cycles each, "
+          "%llu cycles saved\n",
+          zeroed_hit_cnt, zeroed_miss_cnt, idle_zero_cnt, avg_cycles,
+          zeroed_hit_cnt * avg_cycles);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and order_map at its base.
+     Calculate the space needed for them and subtract it from
+     the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  enum intr_level old_level;
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +318,181 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->order_map = (uint8_t *) base + bm_size;
+  memset (p->order_map, 0, page_cnt);
+  for (order = 0; order <= MAX_ORDER; order++)
+    list_init (&p->free_lists[order]);
+  p->zeroed_cnt = 0;
+  p->free_cnt = 0;
   p->base = base + bm_pages * PGSIZE;
+
+  /* All pages start out used; free them into blocks. */
+  bitmap_set_all (p->used_map, true);
+  old_level = intr_disable ();
+  free_pages (p, 0, page_cnt);
+  intr_set_level (old_level);
+}
+
+/* Returns the list_elem kept in POOL's free page PAGE_IDX. */
+static struct list_elem *
+page_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the order of the smallest block that holds PAGE_CNT
+   pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Adds the free block of ORDER at PAGE_IDX in POOL to its free
+   list. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->order_map[page_idx] = FREE_BLOCK | order;
+  list_push_front (&pool->free_lists[order], page_elem (pool, page_idx));
+}
+
+/* Removes the free block at PAGE_IDX in POOL from its free
+   list. */
+static void
+pop_block (struct pool *pool, size_t page_idx)
+{
+  pool->order_map[page_idx] = 0;
+  list_remove (page_elem (pool, page_idx));
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if POOL has no free
+   block large enough. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt)
+{
+  int want = order_for (page_cnt);
+  int order;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (want > MAX_ORDER)
+    return alloc_large (pool, page_cnt);
+
+  for (order = want; order <= MAX_ORDER; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order > MAX_ORDER)
+    return BITMAP_ERROR;
+
+  page_idx = pg_no (list_front (&pool->free_lists[order]))
+             - pg_no (pool->base);
+  pop_block (pool, page_idx);
+
+  /* Split the block down to the order wanted, freeing the upper
+     halves. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+
+  bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order, true);
+  pool->free_cnt -= (size_t) 1 << order;
+
+  /* Give back the pages beyond PAGE_CNT. */
+  if (page_cnt < (size_t) 1 << order)
+    free_pages (pool, page_idx + page_cnt,
+                ((size_t) 1 << order) - page_cnt);
+  return page_idx;
+}
+
+/* Allocates PAGE_CNT contiguous pages, more than fit in one
+   block, from POOL by scanning for consecutive free blocks of
+   order MAX_ORDER.  Returns the index of the first page, or
+   BITMAP_ERROR if there is no such run. */
+static size_t
+alloc_large (struct pool *pool, size_t page_cnt)
+{
+  size_t block_size = (size_t) 1 << MAX_ORDER;
+  size_t block_cnt = DIV_ROUND_UP (page_cnt, block_size);
+  size_t page_total = bitmap_size (pool->used_map);
+  size_t start = 0;
+  size_t run = 0;
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; run < block_cnt && i + block_size <= page_total;
+       i += block_size)
+    if (pool->order_map[i] == (FREE_BLOCK | MAX_ORDER))
+      {
+        if (run++ == 0)
+          start = i;
+      }
+    else
+      run = 0;
+  if (run < block_cnt)
+    return BITMAP_ERROR;
+
+  for (i = 0; i < block_cnt; i++)
+    pop_block (pool, start + i * block_size);
+  bitmap_set_multiple (pool->used_map, start, block_cnt * block_size, true);
+  pool->free_cnt -= block_cnt * block_size;
+
+  /* Give back the pages beyond PAGE_CNT. */
+  if (page_cnt < block_cnt * block_size)
+    free_pages (pool, start + page_cnt, block_cnt * block_size - page_cnt);
+  return start;
+}
+
+/* Frees the PAGE_CNT used pages starting at PAGE_IDX in POOL,
+   merging them with free buddies. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t page_total = bitmap_size (pool->used_map);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  pool->free_cnt += page_cnt;
+
+  /* Free the range as the largest aligned blocks that it is made
+     of. */
+  while (page_cnt > 0)
+    {
+      size_t block = page_idx;
+      int order = 0;
+
+      while (order < MAX_ORDER
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      page_cnt -= (size_t) 1 << order;
+      page_idx += (size_t) 1 << order;
+
+      /* Merge with the buddy for as long as it is free. */
+      while (order < MAX_ORDER)
+        {
+          size_t buddy = block ^ ((size_t) 1 << order);
+          if (buddy + ((size_t) 1 << order) > page_total
+              || pool->order_map[buddy] != (FREE_BLOCK | order))
+            break;
+          pop_block (pool, buddy);
+          if (buddy < block)
+            block = buddy;
+          order++;
+        }
+      push_block (pool, block, order);
+    }
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +506,40 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Takes a pre-zeroed page from POOL and returns it, or returns a
+   null pointer if there is none. */
+static void *
+take_zeroed (struct pool *pool) 
+{
+  enum intr_level old_level;
+  void *page = NULL;
+
+  old_level = intr_disable ();
+  if (pool->zeroed_cnt > 0)
+    {
+      page = pool->zeroed[--pool->zeroed_cnt];
+      zeroed_hit_cnt++;
+    }
+  else
+    zeroed_miss_cnt++;
+  intr_set_level (old_level);
+  return page;
+}
+
+/* Gives POOL's pre-zeroed pages back to its free blocks.
+   Returns true if there were any. */
+static bool
+release_zeroed (struct pool *pool) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (pool->zeroed_cnt == 0)
+    return false;
+  while (pool->zeroed_cnt > 0)
+    {
+      void *page = pool->zeroed[--pool->zeroed_cnt];
+      free_pages (pool, pg_no (page) - pg_no (pool->base), 1);
+    }
+  return true;
+}
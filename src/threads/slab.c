@@ -0,0 +1,258 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab caches.
+
+   malloc() rounds every request up to a power of 2 and serves
+   all requests of a size class from one free list under one
+   lock.  A slab cache instead serves objects of one exact size,
+   typically a single kernel structure, from its own free list
+   and lock.
+
+   Each page that a cache obtains from the page allocator, called
+   a "slab", starts with a header and is divided into as many
+   objects as fit in the rest of the page.  The slab keeps its
+   free objects on a singly linked list.  The cache keeps a list
+   of the slabs that have free objects; full slabs are on no
+   list.  When a slab becomes wholly free it is given back to the
+   page allocator, unless it is the cache's only free slab.
+
+   A cache may have a constructor, which is run on each object
+   once, when its slab is carved.  Objects are expected to be
+   freed in their constructed state, so reusing them skips the
+   constructor's work.  In that case the free list link is kept
+   in a word after each object rather than in the object
+   itself. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Maximum number of caches. */
+#define CACHE_MAX 16
+
+/* A cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of each object in bytes. */
+    size_t link_ofs;            /* Offset of free list link. */
+    size_t stride;              /* Bytes between objects. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct list partial_slabs;  /* Slabs with free objects. */
+    size_t empty_cnt;           /* Slabs with no used objects. */
+    struct lock lock;           /* Lock. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs allocated. */
+    size_t used_cnt;            /* Objects in use. */
+    size_t peak_used_cnt;       /* Maximum of USED_CNT. */
+  };
+
+/* Slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    size_t free_cnt;            /* Free objects. */
+    void *free;                 /* First free object. */
+    struct list_elem elem;      /* Element in PARTIAL_SLABS. */
+  };
+
+/* Our set of caches. */
+static struct kmem_cache caches[CACHE_MAX];
+static size_t cache_cnt;
+
+static struct slab *new_slab (struct kmem_cache *);
+static void **obj_link (const struct kmem_cache *, void *obj);
+
+/* Creates a cache of objects of SIZE bytes, named NAME, that
+   runs CTOR, if nonnull, on each object when it is first
+   carved.  Panics if there are too many caches or if SIZE
+   objects do not fit in a page. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor) 
+{
+  struct kmem_cache *c;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  if (cache_cnt >= CACHE_MAX)
+    PANIC ("too many slab caches");
+  c = &caches[cache_cnt++];
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, sizeof (void *));
+  c->link_ofs = ctor != NULL ? c->obj_size : 0;
+  c->stride = c->link_ofs + (ctor != NULL ? sizeof (void *) : c->obj_size);
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->stride;
+  if (c->objs_per_slab == 0)
+    PANIC ("%s objects of %zu bytes do not fit in a slab", name, size);
+  c->ctor = ctor;
+  list_init (&c->partial_slabs);
+  c->empty_cnt = 0;
+  lock_init (&c->lock);
+  c->slab_cnt = 0;
+  c->used_cnt = 0;
+  c->peak_used_cnt = 0;
+  return c;
+}
+
+/* Obtains and returns a new object from cache C, or a null
+   pointer if no memory is available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (c != NULL);
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->partial_slabs))
+    {
+      s = new_slab (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial_slabs, &s->elem);
+    }
+  else
+    s = list_entry (list_front (&c->partial_slabs), struct slab, elem);
+
+  if (s->free_cnt == c->objs_per_slab)
+    c->empty_cnt--;
+  obj = s->free;
+  s->free = *obj_link (c, obj);
+  if (--s->free_cnt == 0)
+    list_remove (&s->elem);
+
+  if (++c->used_cnt > c->peak_used_cnt)
+    c->peak_used_cnt = c->used_cnt;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to C.
+   OBJ may be a null pointer, in which case nothing happens. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+
+  ASSERT (c != NULL);
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT (((uint8_t *) obj - (uint8_t *) (s + 1)) % c->stride == 0);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it must keep its constructed state. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  *obj_link (c, obj) = s->free;
+  s->free = obj;
+  if (s->free_cnt++ == 0)
+    list_push_front (&c->partial_slabs, &s->elem);
+  c->used_cnt--;
+
+  /* Give the slab back if it is wholly free and is not the only
+     such slab. */
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      if (c->empty_cnt > 0)
+        {
+          list_remove (&s->elem);
+          s->magic = 0;
+          palloc_free_page (s);
+          c->slab_cnt--;
+        }
+      else
+        c->empty_cnt++;
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints the utilization of each cache. */
+void
+kmem_print_stats (void) 
+{
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++)
+    {
+      struct kmem_cache *c = &caches[i];
+      size_t total = c->slab_cnt * c->objs_per_slab;
+      size_t used_bytes = c->used_cnt * c->obj_size;
+      size_t slab_bytes = c->slab_cnt * PGSIZE;
+
+      printf ("Slab %s: %zu of %zu %zu-byte objects in use "
+              "(peak %zu), %zu slabs, %zu%% utilized\n",
+              c->name, c->used_cnt, total, c->obj_size,
+              c->peak_used_cnt, c->slab_cnt,
+              slab_bytes > 0 ? used_bytes * 100 / slab_bytes : 0);
+    }
+}
+
+/* Obtains a page for cache C, carves it into objects, and
+   returns it, or returns a null pointer if no page is
+   available. */
+static struct slab *
+new_slab (struct kmem_cache *c) 
+{
+  struct slab *s;
+  uint8_t *obj;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  s->free = NULL;
+
+  /* Push the objects in reverse so that they are handed out in
+     address order. */
+  obj = (uint8_t *) (s + 1) + c->stride * c->objs_per_slab;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      obj -= c->stride;
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *obj_link (c, obj) = s->free;
+      s->free = obj;
+    }
+
+  c->slab_cnt++;
+  c->empty_cnt++;
+  return s;
+}
+
+/* Returns the free list link of OBJ in cache C. */
+static void **
+obj_link (const struct kmem_cache *c, void *obj) 
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
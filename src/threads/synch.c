@@ -231,7 +231,7 @@ lock_acquire (struct lock *lock)
              Therefore, it is needed to backup its own priority. */
           t->original_priority = t->priority;
         }
-      t->priority = cur->priority;
+      thread_update_priority (t, cur->priority);
       /* Remember the current thread as a donor */      
       list_push_back (&t->donor_list, &cur->donor_list_elem);
 
@@ -240,7 +240,7 @@ lock_acquire (struct lock *lock)
       while (t->wait_on != NULL && i < nested_depth)
         {
           t = t->wait_on->holder;
-          t->priority = cur->priority;
+          thread_update_priority (t, cur->priority);
           i++;
         }
     }
@@ -344,6 +344,7 @@ struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
 /* Initializes condition variable COND.  A condition variable
@@ -388,6 +389,7 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -438,6 +440,101 @@ cond_broadcast (struct condition *cond, struct lock *lock)
     cond_signal (cond, lock);
 }
 
+/* Initializes RW as a readers-writer lock.  Any number of
+   readers may hold RW at once, or a single writer.  Readers
+   arriving while a writer waits queue up behind it, so that a
+   stream of readers cannot starve writers.  Unlike a lock, RW
+   does not take part in priority donation. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->readers);
+  cond_init (&rw->writers);
+  rw->reader_cnt = 0;
+  rw->writer_waiting = 0;
+  rw->writer = NULL;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it or
+   waits for it.  RW must not already be held for writing by the
+   current thread. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != thread_current ());
+
+  lock_acquire (&rw->lock);
+  while (rw->writer != NULL || rw->writer_waiting > 0)
+    cond_wait (&rw->readers, &rw->lock);
+  rw->reader_cnt++;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for
+   reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->reader_cnt > 0);
+  if (--rw->reader_cnt == 0)
+    cond_signal (&rw->writers, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != thread_current ());
+
+  lock_acquire (&rw->lock);
+  rw->writer_waiting++;
+  while (rw->writer != NULL || rw->reader_cnt > 0)
+    cond_wait (&rw->writers, &rw->lock);
+  rw->writer_waiting--;
+  rw->writer = thread_current ();
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for
+   writing.  Waiting writers go first; readers are let in once
+   none is left. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_by_current_thread (rw));
+
+  lock_acquire (&rw->lock);
+  rw->writer = NULL;
+  if (rw->writer_waiting > 0)
+    cond_signal (&rw->writers, &rw->lock);
+  else
+    cond_broadcast (&rw->readers, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing,
+   false otherwise. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
 bool
 semaphore_elem_less (const struct list_elem *a,
                      const struct list_elem *b,
@@ -445,18 +542,11 @@ semaphore_elem_less (const struct list_elem *a,
 {
   struct semaphore_elem
     *sema_elem_a, *sema_elem_b;
-  struct thread
-    *thread_a, *thread_b;
 
   sema_elem_a = list_entry (a, struct semaphore_elem, elem);
   sema_elem_b = list_entry (b, struct semaphore_elem, elem);
-  
-  thread_a
-    = list_entry (list_front (&sema_elem_a->semaphore.waiters),
-                  struct thread, elem);
-  thread_b
-    = list_entry (list_front (&sema_elem_b->semaphore.waiters),
-                  struct thread, elem);
-
-  return thread_a->priority < thread_b->priority;
+
+  /* Not the semaphores' waiter lists: a waiter may not have
+     reached sema_down() yet. */
+  return sema_elem_a->thread->priority < sema_elem_b->thread->priority;
 }
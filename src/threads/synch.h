@@ -41,6 +41,24 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition readers;   /* Waiting readers. */
+    struct condition writers;   /* Waiting writers. */
+    unsigned reader_cnt;        /* Number of readers holding. */
+    unsigned writer_waiting;    /* Number of writers waiting. */
+    struct thread *writer;      /* Writer holding, if any. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
 bool
 semaphore_elem_less (const struct list_elem *,
                      const struct list_elem *,
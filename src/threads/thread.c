@@ -21,25 +21,22 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue: processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+
+   There is one FIFO list per priority level.  Bit P of
+   READY_MASK is set if and only if READY_QUEUES[P] is nonempty,
+   so that the highest priority ready thread is found with a
+   couple of bit scans instead of a walk over every ready
+   thread. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static size_t ready_cnt;        /* # of threads in all ready queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* List of sleeping processes, that is, processes
-   who previously called timer_sleep() and became blocked. */
-static struct list sleep_list;
-
-/* Wake-up time of the thread who should wake up "first"
-   among sleeping thread. */
-static int64_t earliest_wakeup_ticks;
-
-#define EARLIER(TICKS) \
-        (((earliest_wakeup_ticks) > (TICKS)) ? (TICKS) : (earliest_wakeup_ticks))
-
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -72,6 +69,19 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 bool thread_mlfqs;
 static int load_avg;            /* mlfqs, fixed-point. */
 
+/* mlfqs: recent_cpu decay history.  Once a second, the running
+   and ready threads have their recent_cpu decayed right away.
+   Blocked threads, which may be the vast majority, are brought
+   up to date only when they are unblocked, by replaying the
+   decay coefficients of the seconds they missed, which are
+   kept here.  DECAY[S % DECAY_HISTORY] is the coefficient used
+   at the end of second S. */
+#define DECAY_HISTORY 128
+static int decay[DECAY_HISTORY];        /* Fixed-point. */
+static int mlfqs_seconds;       /* # of decays so far. */
+
+static void mlfqs_catch_up (struct thread *);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -80,6 +90,9 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
@@ -100,15 +113,17 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
+  ready_mask = 0;
+  ready_cnt = 0;
   list_init (&all_list);
 
-  list_init (&sleep_list);
-  earliest_wakeup_ticks = INT64_MAX;
-
   load_avg = 0;
 
   /* Set up a thread structure for the running thread. */
@@ -263,8 +278,10 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  if (thread_mlfqs)
+    mlfqs_catch_up (t);
   t->status = THREAD_READY;
+  ready_queue_push (t);
 
   /* When a thread is added to the ready list that has a higher
      priority than the currently running thread, the current thread
@@ -353,69 +370,13 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
   cur->status = THREAD_READY;
-  schedule ();
-  intr_set_level (old_level);
-}
-
-/* Suspends execution of the calling thread until until
-   timer `ticks' reaches `wakeup_ticks'. */
-void
-thread_sleep (int64_t wakeup_ticks)
-{
-  struct thread *cur = thread_current ();
-  enum intr_level old_level;
-
-  old_level = intr_disable ();  
   if (cur != idle_thread) 
-    list_push_back (&sleep_list, &cur->elem);
-  cur->wakeup_ticks = wakeup_ticks;
-  earliest_wakeup_ticks = EARLIER (wakeup_ticks);
-  thread_block ();
+    ready_queue_push (cur);
+  schedule ();
   intr_set_level (old_level);
 }
 
-/* When there is a thread to wake up, find and unblock
-   the thread. There can be more than one thread who should
-   wake up. */
-void
-thread_wakeup (int64_t ticks)
-{
-  /* There is no thread to wake up. */
-  if (ticks < earliest_wakeup_ticks)
-    return;
-  
-  /* At least one thread should wake up. */
-  struct list_elem *min = list_begin (&sleep_list);
-  struct list_elem *e;
-  for (e = min; e != list_end (&sleep_list);
-       /**/)
-    {
-      struct thread *t = list_entry (e, struct thread, elem);
-      /* Wake up this thread. */
-      if (ticks >= t->wakeup_ticks)
-        {
-          e = list_remove (e);
-          thread_unblock (t);
-        }
-      else
-        {
-          /* Finds a thread with smallest wakeup_ticks
-             except the threads to wake up. */
-          struct thread *min_t = list_entry (min, struct thread, elem);
-          if (t->wakeup_ticks < min_t->wakeup_ticks)
-            min = e;
-          e = list_next (e);
-        }
-    }
-
-  /* There are no sleeping threads left. */
-  if (list_empty (&sleep_list))
-    earliest_wakeup_ticks = INT64_MAX;
-}
-
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -481,14 +442,8 @@ thread_set_nice (int nice)
   cur->nice = nice;
   cur->priority = mlfqs_priority_formula (cur);
 
-  if (!list_empty (&ready_list))
-    {
-      struct thread *max
-        = list_entry (list_max (&ready_list, thread_priority_less, NULL),
-                      struct thread, elem);
-      if (cur->priority < max->priority)
-        thread_yield ();
-    }
+  if (cur->priority < ready_queue_max_priority ())
+    thread_yield ();
   
   intr_set_level (old_level);
 }
@@ -551,7 +506,7 @@ mlfqs_ready_threads ()
     = (thread_current () != idle_thread)
        ? 1
        : 0;
-  return list_size (&ready_list) + addend;
+  return ready_cnt + addend;
 }
 
 int
@@ -575,15 +530,20 @@ mlfqs_priority_formula (struct thread *t)
 }
 
 int   /* fixed-point */
-mlfqs_recent_cpu_formula (struct thread *t)
+mlfqs_decay_formula (void)
 {
-  /* `load_avg' is fixed point real number.
+  /* `load_avg' is fixed point real number. */
+  int load_avg2 = mul_fi (load_avg, 2);
+  return div_ff (load_avg2, add_fi (load_avg2, 1));
+}
+
+int   /* fixed-point */
+mlfqs_recent_cpu_formula (struct thread *t, int decay)
+{
+  /* `decay' is fixed point real number.
      `recent_cpu' is fixed point real number.
      `nice' is just an integer. */
-  int load_avg2 = mul_fi (load_avg, 2);
-  return add_fi (mul_ff (div_ff (load_avg2, add_fi (load_avg2, 1)),
-                         t->recent_cpu),
-                 t->nice);
+  return add_fi (mul_ff (decay, t->recent_cpu), t->nice);
 }
 
 int   /* fixed-point */
@@ -607,18 +567,46 @@ mlfqs_increment_recent_cpu (void)
     }
 }
 
-/* Recalculates priority. Used with thread_foreach(). */
+/* Recalculates priority.  A ready thread moves to another run
+   queue only if its priority actually changes. */
 void
-mlfqs_recalc_priority (struct thread *t, void *aux UNUSED)
+mlfqs_recalc_priority (struct thread *t)
 {
-  t->priority = mlfqs_priority_formula (t);
+  thread_update_priority (t, mlfqs_priority_formula (t));
 }
 
-/* Recalculates recent_cpu. Used with thread_foreach(). */
+/* Decays recent_cpu once a second.  Only the running thread and
+   the ready threads are updated now, so the cost does not
+   depend on how many threads are blocked; see mlfqs_catch_up().
+   Must be called with interrupts off, after load_avg has been
+   updated. */
 void
-mlfqs_recalc_recent_cpu (struct thread *t, void *aux UNUSED)
+mlfqs_decay_recent_cpu (void)
 {
-  t->recent_cpu = mlfqs_recent_cpu_formula (t);
+  struct thread *cur = thread_current ();
+  int pri;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  decay[mlfqs_seconds % DECAY_HISTORY] = mlfqs_decay_formula ();
+  mlfqs_seconds++;
+
+  if (cur != idle_thread)
+    mlfqs_catch_up (cur);
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    {
+      struct list *q = &ready_queues[pri];
+      struct list_elem *e, *next;
+
+      /* mlfqs_catch_up() may move T to another queue, where it
+         is skipped for being up to date already. */
+      for (e = list_begin (q); e != list_end (q); e = next)
+        {
+          struct thread *t = list_entry (e, struct thread, elem);
+          next = list_next (e);
+          mlfqs_catch_up (t);
+        }
+    }
 }
 
 /* Updates load_avg. */
@@ -627,6 +615,44 @@ mlfqs_update_load_avg (void)
 {
   load_avg = mlfqs_load_avg_formula ();
 }
+
+/* Applies to T's recent_cpu the decays it has missed since it
+   was last brought up to date, and recalculates its priority.
+
+   Only the last DECAY_HISTORY coefficients are remembered.  A
+   thread that has been blocked for longer than that has the
+   oldest coefficient applied for each of the older seconds, for
+   at most DECAY_HISTORY more rounds, which is plenty for
+   recent_cpu to have settled anyway. */
+static void
+mlfqs_catch_up (struct thread *t)
+{
+  int missed = mlfqs_seconds - t->recent_cpu_epoch;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (missed >= 0);
+
+  if (missed == 0)
+    return;
+  if (missed > DECAY_HISTORY)
+    {
+      int oldest = decay[mlfqs_seconds % DECAY_HISTORY];
+      int extra = missed - DECAY_HISTORY;
+
+      if (extra > DECAY_HISTORY)
+        extra = DECAY_HISTORY;
+      while (extra-- > 0)
+        t->recent_cpu = mlfqs_recent_cpu_formula (t, oldest);
+      missed = DECAY_HISTORY;
+    }
+  while (missed > 0)
+    {
+      int s = mlfqs_seconds - missed--;
+      t->recent_cpu = mlfqs_recent_cpu_formula (t, decay[s % DECAY_HISTORY]);
+    }
+  t->recent_cpu_epoch = mlfqs_seconds;
+  mlfqs_recalc_priority (t);
+}
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
@@ -646,6 +672,9 @@ idle (void *idle_started_ UNUSED)
 
   for (;;) 
     {
+      /* Use the spare time to zero free pages for later. */
+      palloc_zero_idle ();
+
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
@@ -729,14 +758,16 @@ init_thread (struct thread *t, const char *name, int priority)
     = (t != initial_thread)
       ? thread_current ()->recent_cpu   /* From parent thread. */
       : 0;
+  t->recent_cpu_epoch = mlfqs_seconds;
 
   /* Process hierarchy */
   list_init (&t->child_list);
   t->process = NULL;
 
   /* File descriptors. */
-  list_init (&t->fd_list);
-  t->next_fd_no = 2;
+  t->fd_table = NULL;
+  t->fd_table_size = 0;
+  t->fd_free = 2;
 
 #ifdef VM
   /* Supplemental page table. */
@@ -773,20 +804,88 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  int priority = ready_queue_max_priority ();
+  if (priority < PRI_MIN)
     return idle_thread;
   else
     {
       /* Among the ready threads, the highest priority thread
-         should be scheduled to run first.*/
+         should be scheduled to run first.  Threads of equal
+         priority run in the order they became ready. */
       struct thread *t
-        = list_entry (list_max (&ready_list, thread_priority_less, NULL),
+        = list_entry (list_front (&ready_queues[priority]),
                       struct thread, elem);
-      list_remove(&t->elem);
+      ready_queue_remove (t);
       return t;
     }
 }
 
+/* Appends ready thread T to the run queue of its priority. */
+static void
+ready_queue_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_queues[t->priority], &t->elem);
+  ready_mask |= (uint64_t) 1 << t->priority;
+  ready_cnt++;
+}
+
+/* Removes T from the run queue of its priority. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_mask &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
+}
+
+/* Returns the priority of the highest priority ready thread,
+   or PRI_MIN - 1 if no thread is ready. */
+static int
+ready_queue_max_priority (void)
+{
+  uint32_t high = ready_mask >> 32;
+  uint32_t low = ready_mask;
+
+  /* Bit scan reverse on whichever half is nonzero. */
+  if (high != 0)
+    return 63 - __builtin_clz (high);
+  else if (low != 0)
+    return 31 - __builtin_clz (low);
+  else
+    return PRI_MIN - 1;
+}
+
+/* Sets T's priority to PRIORITY.  If T is waiting in the run
+   queue, it is moved to the queue for its new priority.
+   Used when T's priority changes behind its back, e.g. by
+   priority donation or by the advanced scheduler. */
+void
+thread_update_priority (struct thread *t, int priority)
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_READY && t->priority != priority)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else
+    t->priority = priority;
+  intr_set_level (old_level);
+}
+
 /* Completes a thread switch by activating the new thread's page
    tables, and, if the previous thread is dying, destroying it.
 
@@ -96,9 +96,6 @@ struct thread
     int priority;                       /* Priority. */
     struct list_elem allelem;           /* List element for all threads list. */
 
-    /* Owned by thread.c. */
-    int64_t wakeup_ticks;               /* Wake-up ticks since OS booted. */
-
     /* Owned by thread.c. */
     int original_priority;              /* Original priority */
     struct list donor_list;             /* Priority donors */
@@ -108,6 +105,7 @@ struct thread
     /* Owned by thread.c. */
     int nice;                           /* mlfqs. */
     int recent_cpu;                     /* mlfqs, fixed-point. */
+    int recent_cpu_epoch;               /* mlfqs, # of decays applied. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
@@ -119,8 +117,9 @@ struct thread
 
     /* Shared between thread.c and
        userprog/syscall.c. */
-    struct list fd_list;                /* List of file descriptors. */
-    int next_fd_no;                     /* Next file descriptor number. */
+    struct file **fd_table;             /* Open files, indexed by fd. */
+    int fd_table_size;                  /* Number of slots in FD_TABLE. */
+    int fd_free;                        /* No lower fd is unused. */
 
     /* Shared between thread.c and
        userprog/process.c. */
@@ -174,9 +173,6 @@ const char *thread_name (void);
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 
-void thread_sleep (int64_t wakeup_ticks);
-void thread_wakeup (int64_t ticks);
-
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
@@ -184,6 +180,7 @@ void thread_foreach (thread_action_func *, void *);
 int thread_get_priority (void);
 void thread_set_priority (int);
 
+void thread_update_priority (struct thread *, int);
 void thread_donate_priority (struct thread *);
 void thread_recall_donation (struct thread *);
 
@@ -198,13 +195,14 @@ bool thread_priority_less (const struct list_elem *,
 
 /* Getters. */
 int mlfqs_priority_formula (struct thread *);
-int mlfqs_recent_cpu_formula (struct thread *);
+int mlfqs_decay_formula (void);
+int mlfqs_recent_cpu_formula (struct thread *, int decay);
 int mlfqs_load_avg_formula (void);
 
 /* Setters. */
 void mlfqs_increment_recent_cpu (void);
-void mlfqs_recalc_priority (struct thread *, void *);
-void mlfqs_recalc_recent_cpu (struct thread *, void *);
+void mlfqs_recalc_priority (struct thread *);
+void mlfqs_decay_recent_cpu (void);
 void mlfqs_update_load_avg (void);
 
 #endif /* threads/thread.h */
@@ -195,13 +195,24 @@ page_fault (struct intr_frame *f)
      process has already created SPTEs.
      See load_segment() defined in userprog/process.c.
      
-     Similarly, stack growth is considered as lazy loading. */
+     Similarly, stack growth is considered as lazy loading.
+     A page of zeros that is only read is mapped to a shared
+     zero page instead. */
   if (not_present)
     {
+      if (!write && page_map_zero (fault_page))
+        return;
       if (!page_load (fault_page))
         sys_exit (-1);
       return;
     }
+
+  /* A writable page that fork() shared with another process is
+     mapped read-only until the first write to it, which gets a
+     copy of the page.  Any other write to a read-only page is
+     handled below. */
+  if (write && is_user_vaddr (fault_addr) && page_write_fault (fault_page))
+    return;
 #endif
 
   /* A page fault in the kernel merely sets EAX to 0xffffffff and
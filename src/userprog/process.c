@@ -23,17 +23,14 @@
 #include "vm/page.h"
 
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 static bool load (const char *exec_path, void (**eip) (void), void **esp);
 static void init_process (struct process *process, tid_t tid);
 static bool init_stack (void **esp, char *cmdline);
 static void push_stack (void **esp, void *src, size_t size);
 
-/* It is not safe to call into the file system code
-   provided in the `filesys' directory from multiple threads
-   at once.
-   The file system code is treated as a critical section. */
-extern struct lock fs_lock;
-
 /* Shared between `process_execute' and `process_start'. */
 struct process_exec_params
   {
@@ -114,9 +111,7 @@ start_process (void *params_)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  lock_acquire (&fs_lock);
   success = load (thread_name (), &if_.eip, &if_.esp);
-  lock_release (&fs_lock);
 
   /* Initialize stack with passed arguments. */
   if (success)
@@ -161,6 +156,102 @@ start_process (void *params_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Shared between `process_fork' and `start_fork'. */
+struct process_fork_params
+  {
+    struct thread *parent;              /* Forking thread. */
+    struct intr_frame *if_;             /* Parent's user context. */
+
+    /* The parent cannot return from `process_fork' until the
+       child has copied its address space and open files, which
+       it must not change in the meantime. */
+    struct semaphore fork_wait;
+    bool fork_success;                  /* Is the copy successful? */
+    struct process *process;            /* Child process block. */
+  };
+
+/* Starts a new thread running a copy of the current user
+   process, which entered the kernel with user context IF_.  The
+   copy resumes from the same context, except that fork() returns
+   0 in it.  Returns the new process's thread id, or TID_ERROR if
+   the copy cannot be made. */
+tid_t
+process_fork (struct intr_frame *if_)
+{
+  struct thread *cur = thread_current ();
+  struct process_fork_params params;
+  tid_t tid;
+
+  params.parent = cur;
+  params.if_ = if_;
+  sema_init (&params.fork_wait, 0);
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, &params);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  sema_down (&params.fork_wait);
+  if (!params.fork_success)
+    return TID_ERROR;
+
+  /* Add child process. */
+  list_push_back (&cur->child_list, &params.process->child_list_elem);
+  return tid;
+}
+
+/* A thread function that copies the parent's user process and
+   starts it running. */
+static void
+start_fork (void *params_)
+{
+  struct process_fork_params *params = params_;
+  struct thread *parent = params->parent;
+  struct thread *cur = thread_current ();
+  struct process *process = NULL;
+  struct intr_frame if_;
+  bool success = false;
+
+  /* Returns 0 from fork() in the child. */
+  if_ = *params->if_;
+  if_.eax = 0;
+
+  cur->spt = page_create_spt ();
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir == NULL)
+    goto done;
+  process_activate ();
+
+  cur->bin = file_reopen (parent->bin);
+  if (cur->bin == NULL)
+    goto done;
+  file_deny_write (cur->bin);
+
+  if (!page_copy_spt (parent) || !sys_fd_fork (parent))
+    goto done;
+
+  if ((process = malloc (sizeof (struct process))) == NULL)
+    goto done;
+  init_process (process, cur->tid);
+  params->process = cur->process = process;
+  success = true;
+
+ done:
+  /* The parent doesn't wait for this child process anymore.
+     See `process_fork' defined above. */
+  params->fork_success = success;
+  sema_up (&params->fork_wait);
+
+  /* If failed, quit. */
+  if (!success)
+    thread_exit ();
+
+  /* Start the user process.  See `start_process'. */
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Does basic initialization of PROCESS. */
 static void
 init_process (struct process *process, tid_t tid)
@@ -318,11 +409,6 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
   
-  /* Close the user program. */
-  lock_acquire (&fs_lock);
-  file_close (cur->bin);
-  lock_release (&fs_lock);
-
   /* Close all open files. */
   sys_fd_exit ();
 
@@ -330,11 +416,17 @@ process_exit (void)
   /* Unmap all mmap mappings. */
   sys_mmap_exit ();
 
-  /* Destroy the current process's supplemental page table. */
+  /* Destroy the current process's supplemental page table.
+     This stops sharing the program's pages with other
+     processes, which must happen while the program file, whose
+     inode identifies them, is still open. */
   if (cur->spt != NULL)
     page_destroy_spt (cur->spt);
 #endif
 
+  /* Close the user program. */
+  file_close (cur->bin);
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
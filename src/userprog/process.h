@@ -31,7 +31,12 @@ struct process
     bool wait_done;                     /* If true, wait call to this process must be ignored. */
   };
 
+struct intr_frame;
+
 tid_t process_execute (const char *cmdline);
+#ifdef VM
+tid_t process_fork (struct intr_frame *);
+#endif
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
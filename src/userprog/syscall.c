@@ -1,5 +1,6 @@
 #include "userprog/syscall.h"
 #include "lib/user/syscall.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "lib/stdio.h"
@@ -8,10 +9,12 @@
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "devices/timer.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #ifdef VM
@@ -23,7 +26,7 @@ static void syscall_handler (struct intr_frame *);
 
 /* Number of system calls. */
 #ifdef VM
-#define SYSCALL_CNT 15
+#define SYSCALL_CNT (SYS_FORK + 1)
 #else
 #define SYSCALL_CNT 13
 #endif
@@ -51,6 +54,11 @@ static void sys_close_wrapper    (struct intr_frame *);
 /* Project 3 and optionally project 4. */
 static void sys_mmap_wrapper     (struct intr_frame *);
 static void sys_munmap_wrapper   (struct intr_frame *);
+
+/* Extensions. */
+static void sys_fork_wrapper     (struct intr_frame *);
+
+static void mmap_init (void);
 #endif
 
 /* Prototypes. */
@@ -70,6 +78,7 @@ void     sys_close (int);
 #ifdef VM
 mapid_t  sys_mmap (int, void *);
 void     sys_munmap (mapid_t);
+pid_t    sys_fork (struct intr_frame *);
 #endif
 
 /* In Pintos, system call number and arguments are all 32-bit
@@ -84,11 +93,34 @@ static sys_wrapper_func *sys_wrap_funcs[SYSCALL_CNT];
    Every user memory access required by system call must be done
    using these helper functions. */
 static long copy_from_user (void *, const void *, size_t);
-static long copy_to_user (void *, const void *, size_t);
 static long strncpy_from_user (char *, const char *, size_t);
+static void *pin_user_page (void *, bool write);
+static void unpin_user_page (void *, bool write);
 
 static void bad_user_access (void);
 
+/* File read and write statistics, kept separately for requests
+   of up to 1 kB, up to 64 kB, and larger, so that the throughput
+   of each request size can be reported at shutdown. */
+#define IO_CLASS_CNT 3
+static const unsigned io_class_max[IO_CLASS_CNT] = {1024, 65536, -1u};
+struct io_stats
+  {
+    long long bytes;                    /* Bytes transferred. */
+    int64_t ticks;                      /* Timer ticks spent. */
+  };
+static struct io_stats read_stats[IO_CLASS_CNT];
+static struct io_stats write_stats[IO_CLASS_CNT];
+
+static void account_io (struct io_stats *, unsigned size, int bytes,
+                        int64_t start);
+
+#ifdef VM
+/* Fork statistics. */
+static unsigned long long fork_cnt;     /* Successful forks. */
+static uint64_t fork_cycles;            /* CPU cycles they took. */
+#endif
+
 /* Makes an address of IDXth syscall argument from
    stack top pointer ESP which is passed in interrupt frame.
    In Pintos, each system call pushes its number and
@@ -126,19 +158,11 @@ static void bad_user_access (void);
         SYSCALL_GET_ARGS2(ESP, DST0, DST1); \
         SYSCALL_GET_ARG(ESP, 2, DST2);
 
-/* It is not safe to call into the file system code
-   provided in the `filesys' directory from multiple threads
-   at once.
-   The file system code is treated as a critical section. */
-struct lock fs_lock;
-
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 
-  lock_init (&fs_lock);
-
   /* Projects 2 and later. */
   sys_wrap_funcs[SYS_HALT]     = sys_halt_wrapper;
   sys_wrap_funcs[SYS_EXIT]     = sys_exit_wrapper;
@@ -158,6 +182,11 @@ syscall_init (void)
   /* Project 3 and optionally project 4. */
   sys_wrap_funcs[SYS_MMAP]     = sys_mmap_wrapper;
   sys_wrap_funcs[SYS_MUNMAP]   = sys_munmap_wrapper;
+
+  /* Extensions. */
+  sys_wrap_funcs[SYS_FORK]     = sys_fork_wrapper;
+
+  mmap_init ();
 #endif
 }
 
@@ -181,7 +210,7 @@ syscall_handler (struct intr_frame *f)
 #endif
 
   /* Invokes system call wrapper function. */
-  if (no < 0 || no >= SYSCALL_CNT)
+  if (no < 0 || no >= SYSCALL_CNT || sys_wrap_funcs[no] == NULL)
     PANIC ("Unknown system call");
   else
     {
@@ -243,32 +272,6 @@ copy_from_user (void *kdst_, const void *usrc_, size_t size)
   return res;
 }
 
-/* Writes SIZE bytes from kernel virtual address KSRC to UDST.
-   If UDST points to kernel memory or causes page fault,
-   returns -1, otherwise returns the number of bytes written. */
-static long
-copy_to_user (void *udst_, const void *ksrc_, size_t size)
-{
-  uint8_t* udst = udst_;
-  const uint8_t* ksrc = ksrc_;
-  long res = 0;
-
-  ASSERT (udst != NULL || size == 0);
-  ASSERT (ksrc != NULL || size == 0);
-
-  for (; size > 0; size--, res++)
-    {
-      /* Assumes that the user address has already been verified
-         to be below PHYS_BASE. */
-      if (!is_user_vaddr (udst + res))
-        bad_user_access ();
-      /* A memory access causes page fault. */
-      if (!put_user (udst + res, ksrc[res]))
-        bad_user_access ();
-    }
-  return res;
-}
-
 /* Copies a string from USRC to UDST.  If USRC is longer than
    SIZE - 1 characters, only SIZE - 1 characters are copied.
    A null terminator is always written to DST, unless SIZE is 0.
@@ -308,6 +311,74 @@ strncpy_from_user (char *kdst, const char *usrc_, size_t size)
   return res;
 }
 
+/* Makes the user page containing UADDR resident and keeps it
+   from being evicted until unpin_user_page(), so that the file
+   system can copy straight between it and its cache instead of
+   through a kernel buffer.  If WRITE is true, the page must be
+   writable by the user.  Returns the kernel virtual address
+   that UADDR maps to, or terminates the process if UADDR is not
+   a valid user address. */
+static void *
+pin_user_page (void *uaddr, bool write)
+{
+  void *upage = pg_round_down (uaddr);
+  int byte;
+
+  /* Touch the page first.  This loads a page that is not
+     present, or grows the stack, and catches invalid and
+     read-only pages the way get_user() and put_user() do. */
+  if (!is_user_vaddr (uaddr))
+    bad_user_access ();
+  if ((byte = get_user (uaddr)) == SYS_BAD_ADDR)
+    bad_user_access ();
+  if (write && !put_user (uaddr, byte))
+    bad_user_access ();
+
+#ifdef VM
+  /* The page may be evicted again before we lock its frame, so
+     retry until the frame we hold is still the page's. */
+  for (;;)
+    {
+      struct page *p = page_lookup (upage);
+      struct frame *f;
+
+      if (p == NULL)
+        bad_user_access ();
+      if ((f = p->frame) == NULL)
+        {
+          if (!page_load (upage))
+            bad_user_access ();
+          continue;
+        }
+
+      frame_lock_acquire (f);
+      if (p->frame == f)
+        return f->kpage + pg_ofs (uaddr);
+      frame_lock_release (f);
+    }
+#else
+  return pagedir_get_page (thread_current ()->pagedir, upage)
+         + pg_ofs (uaddr);
+#endif
+}
+
+/* Releases the user page containing UADDR, which was pinned by
+   pin_user_page() with the same WRITE. */
+static void
+unpin_user_page (void *uaddr, bool write)
+{
+  void *upage = pg_round_down (uaddr);
+
+  /* The kernel wrote the page through its kernel alias, which
+     does not set the dirty bit of the user mapping. */
+  if (write)
+    pagedir_set_dirty (thread_current ()->pagedir, upage, true);
+
+#ifdef VM
+  frame_lock_release (page_lookup (upage)->frame);
+#endif
+}
+
 /* Core system call services.  Each of them provides kernel
    services requested by user program.
    
@@ -385,9 +456,7 @@ sys_create (const char *file, unsigned initial_size)
 
   strncpy_from_user (kstr, file, 256);
 
-  lock_acquire (&fs_lock);
   res = filesys_create (kstr, initial_size);
-  lock_release (&fs_lock);
 
   return res;
 }
@@ -408,38 +477,72 @@ sys_remove (const char *file)
 
   strncpy_from_user (kstr, file, 256);
 
-  lock_acquire (&fs_lock);
   res = filesys_remove (kstr);
-  lock_release (&fs_lock);
 
   return res;
 }
 
-/* A file descriptor. */
-struct file_desc
-  {
-    struct list_elem fd_list_elem;   /* List element. */
-    struct file *file;               /* File. */
-    int no;                          /* File descriptor number. */
-  };
+/* -fd: File descriptors of each process must be below this. */
+int fd_limit = 128;
 
-/* Finds a file descriptor with the given FD_NO.
+/* Each process keeps its open files in FD_TABLE, an array
+   indexed by file descriptor number, so that finding the file
+   for a descriptor takes constant time.  The array starts out
+   with room for FD_TABLE_MIN descriptors and doubles whenever
+   it fills up, but never grows beyond FD_LIMIT entries.
+   Slots 0 and 1, the console, are never used. */
+#define FD_TABLE_MIN 16
+
+/* Finds the file open as FD_NO.
    If not found, returns NULL. */
-static struct file_desc *
+static struct file *
 lookup_fd (int fd_no)
 {
   struct thread *cur = thread_current ();
-  struct list *fd_list = &cur->fd_list;
-  struct list_elem *e;
-  for (e = list_begin (fd_list); e != list_end (fd_list);
-       e = list_next (e))
+
+  if (fd_no < 2 || fd_no >= cur->fd_table_size)
+    return NULL;
+  return cur->fd_table[fd_no];
+}
+
+/* Installs F as the lowest-numbered unused file descriptor of the
+   current process and returns it, growing the table if needed.
+   Returns -1 if the process already has FD_LIMIT descriptors or
+   memory is exhausted. */
+static int
+install_fd (struct file *f)
+{
+  struct thread *cur = thread_current ();
+  int fd_no;
+
+  /* No descriptor below FD_FREE is unused, so the search starts
+     there. */
+  for (fd_no = cur->fd_free; fd_no < cur->fd_table_size; fd_no++)
+    if (cur->fd_table[fd_no] == NULL)
+      break;
+
+  if (fd_no >= fd_limit)
+    return -1;
+  if (fd_no == cur->fd_table_size)
     {
-      struct file_desc *fd
-        = list_entry (e, struct file_desc, fd_list_elem);
-      if (fd->no == fd_no)
-        return fd;
+      int new_size = fd_no < FD_TABLE_MIN ? FD_TABLE_MIN : fd_no * 2;
+      struct file **new_table;
+      int i;
+
+      if (new_size > fd_limit)
+        new_size = fd_limit;
+      new_table = realloc (cur->fd_table, new_size * sizeof *new_table);
+      if (new_table == NULL)
+        return -1;
+      for (i = cur->fd_table_size; i < new_size; i++)
+        new_table[i] = NULL;
+      cur->fd_table = new_table;
+      cur->fd_table_size = new_size;
     }
-  return NULL;
+
+  cur->fd_table[fd_no] = f;
+  cur->fd_free = fd_no + 1;
+  return fd_no;
 }
 
 /* Opens the file given the path FILE.  It returns a file descriptor
@@ -447,9 +550,11 @@ lookup_fd (int fd_no)
    reserved for the console; STDIN_FILENO for standard input and
    STDOUT_FILENO for standard output.
 
-   Each process has an independent set of file descriptors which is not
-   limited on the number, and these file descriptors are not inherited
-   by child processes.
+   Each process has an independent set of file descriptors, and these
+   file descriptors are not inherited by child processes.  The lowest
+   unused descriptor is always returned.  A process may not use
+   descriptors at or above FD_LIMIT, which is set with the -fd kernel
+   option.
 
    It is possible for a single process or different processes to open
    the same file more than once, and each `open' system call returns a
@@ -459,48 +564,35 @@ lookup_fd (int fd_no)
 int
 sys_open (const char *file)
 {
-  struct thread *cur = thread_current ();
   struct file *f;
-  struct file_desc *fd;
   char kstr[256];
+  int fd_no;
 
   if (file == NULL)
     return -1;
 
   strncpy_from_user (kstr, file, 256);
 
-  if ((fd = malloc (sizeof (struct file_desc))) == NULL)
-    return -1;
-
-  lock_acquire (&fs_lock);
   if ((f = filesys_open (kstr)) == NULL)
-    {
-      lock_release (&fs_lock);
-      free (fd);
-      return -1;
-    }
-  lock_release (&fs_lock);
+    return -1;
 
-  fd->file = f;
-  fd->no = cur->next_fd_no++;
-  list_push_back (&cur->fd_list, &fd->fd_list_elem);
+  if ((fd_no = install_fd (f)) == -1)
+    file_close (f);
 
-  return fd->no;
+  return fd_no;
 }
 
 /* Returns the size, in bytes, of the open file FD_NO */
 int
 sys_filesize (int fd_no)
 {
-  struct file_desc *fd;
+  struct file *file;
   int res;
 
-  if ((fd = lookup_fd (fd_no)) == NULL)
+  if ((file = lookup_fd (fd_no)) == NULL)
     return -1;
   
-  lock_acquire (&fs_lock);
-  res = file_length (fd->file);
-  lock_release (&fs_lock);
+  res = file_length (file);
 
   return res;
 }
@@ -513,41 +605,44 @@ sys_filesize (int fd_no)
 int
 sys_read (int fd_no, void *ubuf, unsigned size)
 {
-  struct file_desc *fd;
+  struct file *file;
   int res = 0;
 
   if (ubuf == NULL)
     return -1;
   if (fd_no != STDIN_FILENO
-      && (fd = lookup_fd (fd_no)) == NULL)
+      && (file = lookup_fd (fd_no)) == NULL)
     return -1;
   
   if (fd_no != STDIN_FILENO)
     {
-      char kbuf[256];
-      int read_amount, bytes_read;
+      int64_t start = timer_ticks ();
+      unsigned read_amount;
+      int bytes_read;
       
-      /* Breaks up the BUFFER and reads up to 256-bytes at once. */
+      /* Breaks up the BUFFER at page boundaries and reads each
+         piece directly into the pinned user page. */
       while (size > 0)
         {
-          /* Read is possible up to 256 bytes at once. */
-          read_amount = (size > 256) ? 256 : size;
+          void *kbuf;
 
-          lock_acquire (&fs_lock);
-          bytes_read = file_read (fd->file, kbuf, read_amount);
-          lock_release (&fs_lock); 
+          read_amount = PGSIZE - pg_ofs (ubuf + res);
+          if (read_amount > size)
+            read_amount = size;
 
-          /* Data read is saved in KBUF. */
-          copy_to_user (ubuf + res, kbuf, bytes_read);
-
-          /* If 0 bytes read, terminates the loop. */
-          if (bytes_read == 0)
-            break;
+          kbuf = pin_user_page (ubuf + res, true);
+          bytes_read = file_read (file, kbuf, read_amount);
+          unpin_user_page (ubuf + res, true);
 
           /* Adjusts remaining size and next read position. */
           res += bytes_read;
           size -= bytes_read;
+
+          /* A short read means end of file. */
+          if ((unsigned) bytes_read < read_amount)
+            break;
         }
+      account_io (read_stats, size + res, res, start);
     }
   else
     {
@@ -573,41 +668,45 @@ sys_read (int fd_no, void *ubuf, unsigned size)
 int
 sys_write (int fd_no, const void *ubuf, unsigned size)
 {
-  struct file_desc *fd;
+  struct file *file;
   int res = 0;
 
   if (ubuf == NULL)
     return -1;
   if (fd_no != STDOUT_FILENO
-      && (fd = lookup_fd (fd_no)) == NULL)
+      && (file = lookup_fd (fd_no)) == NULL)
     return -1;
   
   if (fd_no != STDOUT_FILENO)
     {
-      char kbuf[256];
-      int write_amount, bytes_written;
+      int64_t start = timer_ticks ();
+      unsigned write_amount;
+      int bytes_written;
       
-      /* Breaks up the BUFFER and writes up to 256-bytes at once. */
+      /* Breaks up the BUFFER at page boundaries and writes each
+         piece directly from the pinned user page. */
       while (size > 0)
         {
-          /* Write is possible up to 256 bytes at once. */
-          write_amount = (size > 256) ? 256 : size;
-          
-          /* Temporarily copies write data into kernel space. */
-          copy_from_user (kbuf, ubuf + res, write_amount);
-
-          lock_acquire (&fs_lock);
-          bytes_written = file_write (fd->file, kbuf, write_amount);
-          lock_release (&fs_lock);
-
-          /* If 0 bytes written, terminates the loop. */
-          if (bytes_written == 0)
-            break;
+          void *kbuf;
+
+          write_amount = PGSIZE - pg_ofs (ubuf + res);
+          if (write_amount > size)
+            write_amount = size;
+
+          kbuf = pin_user_page ((void *) ubuf + res, false);
+          bytes_written = file_write (file, kbuf, write_amount);
+          unpin_user_page ((void *) ubuf + res, false);
 
           /* Adjusts remaining size and next read position. */
           res += bytes_written;
           size -= bytes_written;
+
+          /* A short write means the disk is full or writes are
+             denied. */
+          if ((unsigned) bytes_written < write_amount)
+            break;
         }
+      account_io (write_stats, size + res, res, start);
     }
   else
     {
@@ -622,13 +721,11 @@ sys_write (int fd_no, const void *ubuf, unsigned size)
 void
 sys_seek (int fd_no, unsigned position)
 {
-  struct file_desc *fd;
-  if ((fd = lookup_fd (fd_no)) == NULL)
+  struct file *file;
+  if ((file = lookup_fd (fd_no)) == NULL)
     return;
   
-  lock_acquire (&fs_lock);
-  file_seek (fd->file, position);
-  lock_release (&fs_lock);
+  file_seek (file, position);
 }
 
 /* Returns the position, in byte offset, of the file if
@@ -636,15 +733,13 @@ sys_seek (int fd_no, unsigned position)
 unsigned
 sys_tell (int fd_no)
 {
-  struct file_desc *fd;
+  struct file *file;
   unsigned res;
   
-  if ((fd = lookup_fd (fd_no)) == NULL)
+  if ((file = lookup_fd (fd_no)) == NULL)
     return -1;
   
-  lock_acquire (&fs_lock);
-  res = file_tell (fd->file);
-  lock_release (&fs_lock);
+  res = file_tell (file);
   
   return res;
 }
@@ -653,17 +748,17 @@ sys_tell (int fd_no)
 void
 sys_close (int fd_no)
 {
-  struct file_desc *fd;
+  struct thread *cur = thread_current ();
+  struct file *file;
   
-  if ((fd = lookup_fd (fd_no)) == NULL)
+  if ((file = lookup_fd (fd_no)) == NULL)
     return;
   
-  lock_acquire(&fs_lock);
-  file_close (fd->file);
-  lock_release (&fs_lock);
+  file_close (file);
 
-  list_remove (&fd->fd_list_elem);
-  free (fd);
+  cur->fd_table[fd_no] = NULL;
+  if (fd_no < cur->fd_free)
+    cur->fd_free = fd_no;
 }
 
 #ifdef VM
@@ -680,6 +775,16 @@ struct mmap
     size_t pages;
   };
 
+/* Memory mappings. */
+static struct kmem_cache *mmap_cache;
+
+/* Initializes the memory mapping cache. */
+static void
+mmap_init (void)
+{
+  mmap_cache = kmem_cache_create ("mmap", sizeof (struct mmap), NULL);
+}
+
 /* Finds a file descriptor with the given FD_NO.
    If not found, returns NULL. */
 static struct mmap *
@@ -729,7 +834,7 @@ mapid_t
 sys_mmap (int fd_no, void *addr)
 {
   struct thread *cur = thread_current ();
-  struct file_desc *fd;
+  struct file *file;
   struct file *f;
   struct mmap *m;
   size_t size;
@@ -739,19 +844,16 @@ sys_mmap (int fd_no, void *addr)
     return -1;
   if (addr == NULL || pg_ofs (addr) != 0)
     return -1;
-  if ((fd = lookup_fd (fd_no)) == NULL)
+  if ((file = lookup_fd (fd_no)) == NULL)
     return -1;
-  if ((m = malloc (sizeof (struct mmap))) == NULL)
+  if ((m = kmem_cache_alloc (mmap_cache)) == NULL)
     return -1;
   
-  lock_acquire (&fs_lock);
-  if ((f = file_reopen (fd->file)) == NULL)
+  if ((f = file_reopen (file)) == NULL)
     {
-      lock_release (&fs_lock);
-      free (m);
+      kmem_cache_free (mmap_cache, m);
       return -1;
     }
-  lock_release (&fs_lock);
 
   m->file = f;
   m->mapid = cur->next_mapid++;
@@ -759,9 +861,7 @@ sys_mmap (int fd_no, void *addr)
   m->pages = 0;
   list_push_back (&cur->mmap_list, &m->mmap_list_elem);
 
-  lock_acquire (&fs_lock);
   size = file_length (m->file);
-  lock_release (&fs_lock);
 
   if (size == 0)
     return -1;
@@ -781,7 +881,7 @@ sys_mmap (int fd_no, void *addr)
         goto munmap;
       m->pages++;
 
-      p->type = PG_FILE;
+      p->type = PG_MMAP;
       p->writable = true;
 
       p->file = f;
@@ -813,6 +913,31 @@ sys_munmap (mapid_t mapid)
   do_munmap (m, true);
 }
 
+/* Creates a new process, the child, which is a copy of the
+   current process, the parent, as it entered the kernel with
+   user context F.  Both return from fork(): the parent with the
+   child's pid, the child with 0.  Returns pid -1 in the parent
+   if the child cannot be created.
+
+   The child gets a copy of the parent's open files, which no
+   longer share file positions once copied.  Memory mappings are
+   not inherited.  The child's memory is a copy of the parent's,
+   but writable pages are only copied once either process writes
+   to them.  Until then, both map the same frames read-only. */
+pid_t
+sys_fork (struct intr_frame *f)
+{
+  uint64_t start = timer_read_tsc ();
+  pid_t pid = process_fork (f);
+
+  if (pid != TID_ERROR)
+    {
+      fork_cnt++;
+      fork_cycles += timer_read_tsc () - start;
+    }
+  return pid;
+}
+
 /* Performs a core functionality of munmap().  It first closes
    the open file and removes mmap entry M from process's mapping
    list.  Then, it writes back every user virtual page to the
@@ -838,28 +963,49 @@ do_munmap (struct mmap* m, bool write)
       ASSERT (p != NULL);
       ASSERT (p->file == m->file);
 
-      /* Here, UPAGE could have been evicted; the current process
-         does not have any virtual mapping for UPAGE.  The function
-         pagedir_is_dirty() returns false, if a page is dirty or
-         "there is no mapping" between UPAGE and a physical frame. */
-      p->dirty |= pagedir_is_dirty (cur->pagedir, p->upage);
-
-      if (write && p->dirty) 
+      /* Write back the page's contents from its frame, locked so
+         that it cannot be evicted meanwhile.  Writing from UPAGE
+         instead could fault while the file system holds a cache
+         entry that an eviction of the same page is waiting for.
+         The page may be evicted before we lock its frame, so
+         retry until the frame we hold is still the page's. */
+      while (write)
         {
-          /* Write back the page's contents. */
-          lock_acquire (&fs_lock);
-          file_write_at (p->file, p->upage, p->read_bytes, p->file_ofs);
-          lock_release (&fs_lock);
+          struct frame *f = p->frame;
+
+          if (f == NULL)
+            {
+              /* Not resident.  Eviction already wrote the page
+                 back unless it went to swap, in which case it is
+                 still dirty and must be brought in. */
+              if (!p->dirty || !page_load (upage))
+                break;
+              continue;
+            }
+
+          frame_lock_acquire (f);
+          if (p->frame == f)
+            {
+              p->dirty |= pagedir_is_dirty (cur->pagedir, upage);
+              if (p->dirty)
+                {
+                  file_write_at (p->file, f->kpage, p->read_bytes,
+                                 p->file_ofs);
+                  p->dirty = false;
+                  pagedir_set_dirty (cur->pagedir, upage, false);
+                }
+              frame_lock_release (f);
+              break;
+            }
+          frame_lock_release (f);
         }
       page_remove_entry (p);
     }
   
-  lock_acquire (&fs_lock);
   file_close (m->file);
-  lock_release (&fs_lock);
   
   list_remove (&m->mmap_list_elem);
-  free (m);
+  kmem_cache_free (mmap_cache, m);
 }
 #endif
 
@@ -868,19 +1014,44 @@ void
 sys_fd_exit (void)
 {
   struct thread *cur = thread_current ();
-  struct list *fd_list = &cur->fd_list;
-  while (!list_empty (fd_list))
-    {
-      struct file_desc *fd
-        = list_entry (list_pop_front (fd_list), struct file_desc,
-                      fd_list_elem);
-      
-      lock_acquire (&fs_lock);
-      file_close (fd->file);
-      lock_release (&fs_lock);
-      
-      free (fd);
-    }
+  int fd_no;
+
+  for (fd_no = 2; fd_no < cur->fd_table_size; fd_no++)
+    file_close (cur->fd_table[fd_no]);
+  free (cur->fd_table);
+  cur->fd_table = NULL;
+  cur->fd_table_size = 0;
+}
+
+/* Gives the current process, just forked from PARENT, a copy of
+   every file PARENT has open, at the same position and under the
+   same file descriptor.  Returns true if successful, false if
+   memory allocation failed. */
+bool
+sys_fd_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  int fd_no;
+
+  if (parent->fd_table_size == 0)
+    return true;
+
+  cur->fd_table = calloc (parent->fd_table_size, sizeof *cur->fd_table);
+  if (cur->fd_table == NULL)
+    return false;
+  cur->fd_table_size = parent->fd_table_size;
+  cur->fd_free = parent->fd_free;
+
+  for (fd_no = 2; fd_no < cur->fd_table_size; fd_no++)
+    if (parent->fd_table[fd_no] != NULL)
+      {
+        struct file *file = file_reopen (parent->fd_table[fd_no]);
+        if (file == NULL)
+          return false;
+        file_seek (file, file_tell (parent->fd_table[fd_no]));
+        cur->fd_table[fd_no] = file;
+      }
+  return true;
 }
 
 #ifdef VM
@@ -1028,7 +1199,68 @@ sys_munmap_wrapper (struct intr_frame *f)
   SYSCALL_GET_ARGS1 (f->esp, &ARG0);
   sys_munmap ((mapid_t) ARG0);
 }
+
+static void
+sys_fork_wrapper (struct intr_frame *f)
+{
+  f->eax = sys_fork (f);
+}
+#endif
+
+/* Adds a read or write request of SIZE bytes, which transferred
+   BYTES bytes and started at timer tick START, to STATS. */
+static void
+account_io (struct io_stats *stats, unsigned size, int bytes,
+            int64_t start)
+{
+  int i;
+
+  for (i = 0; size > io_class_max[i]; i++)
+    continue;
+  stats[i].bytes += bytes;
+  stats[i].ticks += timer_elapsed (start);
+}
+
+/* Prints the throughput of STATS, described by WHAT. */
+static void
+print_io_stats (const char *what, const struct io_stats *stats)
+{
+  long long tenths;
+
+  if (stats->ticks == 0)
+    {
+      printf (", %s %lld bytes", what, stats->bytes);
+      return;
+    }
+  tenths = stats->bytes * TIMER_FREQ * 10 / stats->ticks / (1024 * 1024);
+  printf (", %s %lld bytes at %lld.%lld MB/s",
+          what, stats->bytes, tenths / 10, tenths % 10);
+}
+
+/* Prints file read and write statistics for each request size
+   that was used. */
+void
+syscall_print_stats (void)
+{
+  int i;
+
+  for (i = 0; i < IO_CLASS_CNT; i++)
+    if (read_stats[i].bytes != 0 || write_stats[i].bytes != 0)
+      {
+        if (i < IO_CLASS_CNT - 1)
+          printf ("Syscall: requests up to %u bytes", io_class_max[i]);
+        else
+          printf ("Syscall: requests over %u bytes", io_class_max[i - 1]);
+        print_io_stats ("read", &read_stats[i]);
+        print_io_stats ("wrote", &write_stats[i]);
+        printf ("\n");
+      }
+#ifdef VM
+  if (fork_cnt > 0)
+    printf ("Syscall: %llu forks, %"PRIu64" cycles on average\n",
+            fork_cnt, fork_cycles / fork_cnt);
 #endif
+}
 
 /* Handles invalid user-provided pointer access. */
 static void
@@ -1,15 +1,24 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+
+struct thread;
+
 /* [3.1.5] Accessing User Memory
    The provided code for `get_user' and `put_user' assumes that
    the page fault in the kernel returns -1. */
 #define SYS_BAD_ADDR -1
 
+/* -fd: File descriptors of each process must be below this. */
+extern int fd_limit;
+
 void syscall_init (void);
+void syscall_print_stats (void);
 void sys_exit (int);
 
 void sys_fd_exit (void);
+bool sys_fd_fork (struct thread *);
 void sys_mmap_exit (void);
 
 #endif /* userprog/syscall.h */
@@ -3,11 +3,30 @@
 #include "vm/swap.h"
 #include <list.h>
 #include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
 #include "threads/palloc.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 
+/* Free frame watermarks.  Free frames are the user pool's free
+   pages plus the frames that the pageout daemon has evicted.
+   The daemon is woken whenever fewer than PAGEOUT_LOW frames
+   are free, and then evicts frames until PAGEOUT_HIGH are.
+   Once the user pool alone has PAGEOUT_HIGH free pages again,
+   the evicted frames are given back to it. */
+#define PAGEOUT_LOW 8
+#define PAGEOUT_HIGH 32
+
+/* If false, the pageout daemon is not started, and every frame
+   is evicted by the page fault that needs it.  Set by the kernel
+   command-line option -no-pageout. */
+bool pageout_enabled = true;
+
 /* Mutual exclusion. */
 static struct lock table_lock;
 
@@ -18,64 +37,540 @@ static struct list frame_list;
    frame table. */
 static struct list_elem *hand;
 
+/* Frames evicted by the pageout daemon and not yet reused.
+   Their FTEs have no PAGE. */
+static struct list free_list;
+static size_t free_cnt;
+
+/* Signaled to wake up the pageout daemon. */
+static struct condition pageout_cond;
+
+/* Broadcast when an eviction completes. */
+static struct condition evict_cond;
+
+/* Shared frames, keyed by INODE and OFS. */
+static struct hash share_table;
+
+/* Frame table entries. */
+static struct kmem_cache *frame_cache;
+
+/* Statistics. */
+static unsigned long long pool_alloc_cnt;   /* Frames reused from FREE_LIST. */
+static unsigned long long pageout_cnt;      /* Frames evicted by daemon. */
+static unsigned long long fault_evict_cnt;  /* Frames evicted by faults. */
+static unsigned long long drop_cnt;         /* Clean pages dropped. */
+static unsigned long long file_out_cnt;     /* Pages written to file. */
+static unsigned long long swap_out_cnt;     /* Pages written to swap. */
+static unsigned long long share_map_cnt;    /* Pages mapping shared frames. */
+static unsigned long long share_hit_cnt;    /* Loads saved by sharing. */
+static unsigned long long cow_share_cnt;    /* Pages shared by fork. */
+static unsigned long long cow_copy_cnt;     /* Pages copied on write. */
+static unsigned long long cow_reuse_cnt;    /* Writes to unshared pages. */
+static size_t held_cnt;                     /* Frames held by pages. */
+static size_t peak_held_cnt;                /* Most ever held at once. */
+
+static thread_func pageout_daemon NO_RETURN;
+
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static kmem_ctor_func frame_ctor;
+
 /* Initializes the frame allocatior.
    All allocated frames are stored in the FRAME_LIST and
-   managed globally. */
+   managed globally.  Also starts the pageout daemon, unless it
+   has been disabled. */
 void
 frame_init (void)
 {
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame),
+                                   frame_ctor);
   lock_init (&table_lock);
   list_init (&frame_list);
   hand = NULL;
+
+  list_init (&free_list);
+  free_cnt = 0;
+  cond_init (&pageout_cond);
+  cond_init (&evict_cond);
+  hash_init (&share_table, share_hash, share_less, NULL);
+
+  if (pageout_enabled)
+    thread_create ("pageout", PRI_DEFAULT, pageout_daemon, NULL);
 }
 
+static struct frame *alloc_frame (struct page *, bool zero);
+static struct frame *take_free_frame (struct page *, bool *zeroed);
+static size_t free_frame_cnt (void);
+static void release_free_frames (void);
+static void frame_table_remove (struct frame *);
 static struct frame *frame_advance_hand (void);
-static struct frame *frame_get_victim (void);
-static void frame_do_eviction (struct page *src, struct page *dst);
+static struct frame *frame_get_victim (bool wait);
+static bool frame_was_accessed (struct frame *);
+static void frame_evict (struct frame *);
 
 /* Obtains a single free physical frame and returns a FTE
    corresponding to the kernel virtual address identifying the
    frame obtained from the user pool.
-   If too few pages are available, some frame is evicted.
+   If too few pages are available, a frame that the pageout
+   daemon has already evicted is reused, or, failing that, some
+   frame is evicted.  If P's own frame is still being evicted,
+   waits for that to finish first.
    
    P's FRAME member is also set to the returned FTE. */
 struct frame *
 frame_alloc (struct page *p)
+{
+  return alloc_frame (p, false);
+}
+
+/* Like frame_alloc(), but the frame is filled with zeros,
+   preferably by taking a page that the idle thread has already
+   zeroed. */
+struct frame *
+frame_alloc_zero (struct page *p)
+{
+  return alloc_frame (p, true);
+}
+
+/* Does the work of frame_alloc() and, if ZERO is true,
+   frame_alloc_zero(). */
+static struct frame *
+alloc_frame (struct page *p, bool zero)
 {
   struct frame *f;
-  void *kpage;
+  bool zeroed = false;
 
   lock_acquire (&table_lock);
+  while (p->frame != NULL)
+    cond_wait (&evict_cond, &table_lock);
+
+  f = take_free_frame (p, zero ? &zeroed : NULL);
+  if (f == NULL)
+    {
+      ASSERT (p->owner == thread_current ());
+      f = frame_get_victim (true);
+      frame_evict (f);
+      fault_evict_cnt++;
+
+      /* Transfer the frame (doubly linked). */
+      f->page = p;
+      f->page->frame = f;
+      list_push_back (&frame_list, &f->list_elem);
+    }
 
-  kpage = palloc_get_page (PAL_USER);
+  lock_release (&table_lock);
+
+  if (zero && !zeroed)
+    memset (f->kpage, 0, PGSIZE);
+  return f;
+}
+
+/* Like frame_alloc(), but returns a null pointer instead of
+   evicting a frame if no frame is free.  P must not have a
+   frame. */
+struct frame *
+frame_alloc_free (struct page *p)
+{
+  struct frame *f;
+
+  ASSERT (p->frame == NULL);
+
+  lock_acquire (&table_lock);
+  f = take_free_frame (p, NULL);
+  lock_release (&table_lock);
+  return f;
+}
+
+/* Allocates a frame for P from the user pool or, if the pool is
+   empty, from the frames that the pageout daemon has evicted.
+   Returns the frame locked, or a null pointer if neither has a
+   frame.  Wakes the pageout daemon if frames are running low.
+
+   If ZEROED is nonnull, prefers a page that the idle thread has
+   already zeroed, and sets *ZEROED to true if it got one. */
+static struct frame *
+take_free_frame (struct page *p, bool *zeroed)
+{
+  struct frame *f = NULL;
+  void *kpage = NULL;
+
+  ASSERT (lock_held_by_current_thread (&table_lock));
+
+  if (zeroed != NULL)
+    {
+      kpage = palloc_get_zeroed_page (PAL_USER);
+      *zeroed = kpage != NULL;
+    }
+  if (kpage == NULL)
+    kpage = palloc_get_page (PAL_USER);
   if (kpage != NULL)
     {
-      f = malloc (sizeof (struct frame));
+      f = kmem_cache_alloc (frame_cache);
       if (f == NULL)
         PANIC ("cannot allocate a frame table entry.");
 
       /* F is locked until it is released inside
          page_load(). */
-      lock_init (&f->lock);
       frame_lock_acquire (f);
 
       /* One-to-one correspondence. */
       f->kpage = kpage;
 
+      /* Not shared until page_load() says so. */
+      f->inode = NULL;
+
+      /* Memory pressure is over. */
+      if (free_cnt > 0 && palloc_free_cnt (PAL_USER) >= PAGEOUT_HIGH)
+        release_free_frames ();
+    }
+  else if (!list_empty (&free_list))
+    {
+      f = list_entry (list_pop_front (&free_list),
+                      struct frame, list_elem);
+      free_cnt--;
+      pool_alloc_cnt++;
+      frame_lock_acquire (f);
+    }
+
+  if (f != NULL)
+    {
       /* Doubly linked. */
       f->page = p;
       f->page->frame = f;
-      
       list_push_back (&frame_list, &f->list_elem);
+
+      if (++held_cnt > peak_held_cnt)
+        peak_held_cnt = held_cnt;
     }
-  else
+
+  /* Running low on frames. */
+  if (pageout_enabled && free_frame_cnt () < PAGEOUT_LOW)
+    cond_signal (&pageout_cond, &table_lock);
+
+  return f;
+}
+
+/* Returns the number of frames that take_free_frame() could hand
+   out without evicting one. */
+static size_t
+free_frame_cnt (void)
+{
+  ASSERT (lock_held_by_current_thread (&table_lock));
+
+  return palloc_free_cnt (PAL_USER) + free_cnt;
+}
+
+/* Gives the frames that the pageout daemon has evicted back to
+   the user pool. */
+static void
+release_free_frames (void)
+{
+  ASSERT (lock_held_by_current_thread (&table_lock));
+
+  while (!list_empty (&free_list))
+    {
+      struct frame *f = list_entry (list_pop_front (&free_list),
+                                    struct frame, list_elem);
+      free_cnt--;
+      palloc_free_page (f->kpage);
+      kmem_cache_free (frame_cache, f);
+    }
+}
+
+/* Pageout daemon.  Keeps a reserve of evicted frames ready for
+   page faults to use, so that they need not wait for a victim
+   to be written to swap. */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+  lock_acquire (&table_lock);
+  for (;;)
+    {
+      cond_wait (&pageout_cond, &table_lock);
+      while (free_frame_cnt () < PAGEOUT_HIGH)
+        {
+          struct frame *f = frame_get_victim (false);
+          if (f == NULL)
+            break;
+          frame_evict (f);
+          f->page = NULL;
+          frame_lock_release (f);
+          list_push_back (&free_list, &f->list_elem);
+          free_cnt++;
+          held_cnt--;
+          pageout_cnt++;
+
+          /* Let waiting page faults in between evictions. */
+          lock_release (&table_lock);
+          thread_yield ();
+          lock_acquire (&table_lock);
+        }
+    }
+}
+
+/* Prints frame allocation and eviction statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %llu reused from pageout, %llu evicted by pageout, "
+          "%llu evicted on fault\n",
+          pool_alloc_cnt, pageout_cnt, fault_evict_cnt);
+  printf ("Frame usage: %zu held by pages at most, %zu at shutdown\n",
+          peak_held_cnt, held_cnt);
+  printf ("Evictions: %llu clean pages dropped, %llu written to file, "
+          "%llu written to swap\n", drop_cnt, file_out_cnt, swap_out_cnt);
+  printf ("Shared frames: %zu in use by %llu pages, %llu reads saved\n",
+          hash_size (&share_table), share_map_cnt, share_hit_cnt);
+  printf ("Copy-on-write: %llu pages shared, %llu copied, %llu reused\n",
+          cow_share_cnt, cow_copy_cnt, cow_reuse_cnt);
+}
+
+/* Initializes the parts of a frame table entry that are back in
+   the same state whenever the entry is freed: an unheld lock and
+   no sharers. */
+static void
+frame_ctor (void *f_)
+{
+  struct frame *f = f_;
+
+  lock_init (&f->lock);
+  list_init (&f->sharers);
+}
+
+/* Returns the hash of shared frame E's key. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, share_elem);
+  return hash_int ((int) f->inode ^ f->ofs);
+}
+
+/* Returns true if shared frame A's key is less than B's. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->ofs < b->ofs;
+}
+
+/* Returns the shared frame holding the page at OFS in INODE, or
+   a null pointer if there is none.  The frame table must be
+   locked. */
+static struct frame *
+share_lookup (struct inode *inode, off_t ofs)
+{
+  struct frame key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&table_lock));
+
+  key.inode = inode;
+  key.ofs = ofs;
+  e = hash_find (&share_table, &key.share_elem);
+  return e != NULL ? hash_entry (e, struct frame, share_elem) : NULL;
+}
+
+/* Tries to load read-only file page P, which belongs to the
+   current process, by mapping it to a frame that already holds
+   the same page for some other process.  Returns true if
+   successful, false if there is no such frame. */
+bool
+frame_map_shared (struct page *p)
+{
+  struct frame *f;
+  bool success = false;
+
+  ASSERT (p->owner == thread_current ());
+  ASSERT (p->type == PG_FILE && !p->writable);
+
+  lock_acquire (&table_lock);
+  while (p->frame != NULL)
+    cond_wait (&evict_cond, &table_lock);
+
+  f = share_lookup (file_get_inode (p->file), p->file_ofs);
+  if (f != NULL && f->page->read_bytes == p->read_bytes
+      && pagedir_set_page (p->owner->pagedir, p->upage, f->kpage, false))
     {
-      f = frame_get_victim ();
-      frame_do_eviction (f->page, p);
+      list_push_back (&f->sharers, &p->share_elem);
+      p->frame = f;
+      share_map_cnt++;
+      share_hit_cnt++;
+      success = true;
     }
+  lock_release (&table_lock);
+  return success;
+}
 
+/* Offers frame F, which has just been loaded with a read-only
+   file page and is locked, for sharing with other processes
+   that map the same page.  Does nothing if some other frame is
+   already shared for that page. */
+void
+frame_make_shared (struct frame *f)
+{
+  struct page *p = f->page;
+  struct inode *inode = file_get_inode (p->file);
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->type == PG_FILE && !p->writable);
+  ASSERT (f->inode == NULL);
+
+  lock_acquire (&table_lock);
+  if (share_lookup (inode, p->file_ofs) == NULL)
+    {
+      f->inode = inode;
+      f->ofs = p->file_ofs;
+      hash_insert (&share_table, &f->share_elem);
+      list_push_back (&f->sharers, &p->share_elem);
+      share_map_cnt++;
+    }
   lock_release (&table_lock);
-  return f;
+}
+
+/* Detaches SPTE P, which belongs to the current process, from
+   frame F, which P is mapped to and which must be locked.
+   Returns true if F remains in use by other processes, in which
+   case P is left without a frame or a mapping.  Otherwise,
+   returns false, and F is no longer shared, so the caller may
+   free it. */
+bool
+frame_unshare (struct frame *f, struct page *p)
+{
+  bool in_use = false;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == f);
+  ASSERT (p->owner == thread_current ());
+
+  lock_acquire (&table_lock);
+  if (!list_empty (&f->sharers))
+    {
+      list_remove (&p->share_elem);
+      if (f->inode != NULL)
+        share_map_cnt--;
+      if (list_empty (&f->sharers))
+        {
+          if (f->inode != NULL)
+            hash_delete (&share_table, &f->share_elem);
+          f->inode = NULL;
+        }
+      else
+        {
+          /* Keep P's physical page from being freed along with
+             P's page directory. */
+          if (f->page == p)
+            f->page = list_entry (list_front (&f->sharers),
+                                  struct page, share_elem);
+          pagedir_clear_page (p->owner->pagedir, p->upage);
+          p->frame = NULL;
+          in_use = true;
+        }
+    }
+  lock_release (&table_lock);
+  return in_use;
+}
+
+/* Shares frame F, which holds writable page P of the current
+   process's parent and must be locked, with P's copy C in the
+   current process.  Both P and C are mapped to F read-only, so
+   that whichever is written to first gets a copy of its own
+   from frame_break_cow().  Returns true if successful, false if
+   memory allocation failed. */
+bool
+frame_share_cow (struct frame *f, struct page *p, struct page *c)
+{
+  bool success = false;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == f && f->inode == NULL);
+  ASSERT (c->owner == thread_current () && c->frame == NULL);
+
+  lock_acquire (&table_lock);
+  if (pagedir_set_page (c->owner->pagedir, c->upage, f->kpage, false))
+    {
+      /* P may already share F with other processes, in which case
+         it is mapped read-only already. */
+      if (list_empty (&f->sharers))
+        {
+          p->dirty |= pagedir_is_dirty (p->owner->pagedir, p->upage);
+          pagedir_clear_page (p->owner->pagedir, p->upage);
+          pagedir_set_page (p->owner->pagedir, p->upage, f->kpage, false);
+          list_push_back (&f->sharers, &p->share_elem);
+        }
+      c->dirty = p->dirty;
+      list_push_back (&f->sharers, &c->share_elem);
+      c->frame = f;
+      cow_share_cnt++;
+      success = true;
+    }
+  lock_release (&table_lock);
+  return success;
+}
+
+/* Handles a write to page P of the current process, which is
+   shared copy-on-write through frame F.  F must be locked.  If
+   other pages still share F, P is given a copy of F's contents
+   in a new frame of its own; otherwise P simply takes F over.
+   Either way, P ends up mapped writable, and F is left locked. */
+void
+frame_break_cow (struct frame *f, struct page *p)
+{
+  struct frame *copy;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == f && f->inode == NULL);
+  ASSERT (p->owner == thread_current () && p->writable);
+
+  lock_acquire (&table_lock);
+  if (list_empty (&f->sharers))
+    {
+      /* F was evicted and loaded again since P faulted, so it
+         is mapped writable already. */
+      lock_release (&table_lock);
+      return;
+    }
+  list_remove (&p->share_elem);
+  if (list_empty (&f->sharers))
+    {
+      ASSERT (f->page == p);
+      pagedir_clear_page (p->owner->pagedir, p->upage);
+      pagedir_set_page (p->owner->pagedir, p->upage, f->kpage, true);
+      cow_reuse_cnt++;
+      lock_release (&table_lock);
+      return;
+    }
+  if (f->page == p)
+    f->page = list_entry (list_front (&f->sharers),
+                          struct page, share_elem);
+  pagedir_clear_page (p->owner->pagedir, p->upage);
+  p->frame = NULL;
+  cow_copy_cnt++;
+  lock_release (&table_lock);
+
+  /* F stays locked, so it cannot be chosen as the victim that
+     gives us COPY. */
+  copy = frame_alloc (p);
+  memcpy (copy->kpage, f->kpage, PGSIZE);
+  if (!pagedir_set_page (p->owner->pagedir, p->upage, copy->kpage, true))
+    NOT_REACHED ();
+  frame_lock_release (copy);
+}
+
+/* Removes F from the frame table, moving HAND back if it
+   points to F. */
+static void
+frame_table_remove (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&table_lock));
+
+  if (hand == &f->list_elem)
+    hand = list_prev (hand) != list_head (&frame_list)
+           ? list_prev (hand) : NULL;
+  list_remove (&f->list_elem);
 }
 
 /* Circularly advances the iterator HAND. */
@@ -93,85 +588,175 @@ frame_advance_hand (void)
   return list_entry (hand, struct frame, list_elem);
 }
 
-/* Selects a victim physical frame and returns the
-   corresponding FTE. */
+/* Selects a victim physical frame, removes it from the frame
+   table, and returns the corresponding FTE locked.
+   If WAIT is false, gives up and returns a null pointer after
+   two full sweeps of the table without finding a victim;
+   otherwise keeps looking. */
 static struct frame *
-frame_get_victim (void)
+frame_get_victim (bool wait)
 {
   ASSERT (lock_held_by_current_thread (&table_lock));
-  ASSERT (!list_empty (&frame_list));
+  ASSERT (!wait || !list_empty (&frame_list));
 
+  size_t scanned = 0;
+  size_t scan_limit;
   struct frame *f;
+
+  if (list_empty (&frame_list))
+    return NULL;
+
+  /* Two sweeps give every frame's accessed bit a chance to be
+     cleared and then found clear.  The table is locked, so its
+     size does not change while we scan. */
+  scan_limit = 2 * list_size (&frame_list);
   while ((f = frame_advance_hand ()))
     {
       ASSERT (f->page != NULL);
 
+      if (!wait && ++scanned > scan_limit)
+        return NULL;
+
       if (!frame_lock_try_acquire (f))
         continue;
-      if (page_was_accessed (f->page))
+      if (frame_was_accessed (f))
         {
           frame_lock_release (f);
           continue;
         }
 
-      list_remove (&f->list_elem);
+      frame_table_remove (f);
       return f;
     }
   NOT_REACHED ();
 }
 
-/* Performs frame eviction.
-   Deprives SRC of its FTE and pyhsical frame, and gives them
-   to DST.
-   The SPTE SRC must have FTE and physical frame allocated to
-   it, and the FTE and SRC must point to each other.
-   DST must not have FTE and physical frame allocated to it. */
-static void
-frame_do_eviction (struct page *src, struct page *dst)
+/* Returns true if any page that F is mapped to has been
+   accessed since the last call, and resets their accessed
+   bits. */
+static bool
+frame_was_accessed (struct frame *f)
 {
-  ASSERT (src != NULL);
-  ASSERT (src->frame != NULL);
-  ASSERT (src->frame->page == src);
+  struct list_elem *e;
+  bool accessed = false;
 
-  ASSERT (dst != NULL);
-  ASSERT (dst->frame == NULL);
-  ASSERT (dst->owner == thread_current ());
+  if (list_empty (&f->sharers))
+    return page_was_accessed (f->page);
 
-  ASSERT (lock_held_by_current_thread (&table_lock));
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    if (page_was_accessed (list_entry (e, struct page, share_elem)))
+      accessed = true;
+  return accessed;
+}
 
-  struct frame *f = src->frame;
+/* Evicts frame F, which frame_get_victim() returned, from the
+   page it holds.  That page's mapping is removed.  If the page
+   has been changed, its contents are saved: a memory-mapped
+   page is written back to its file, anything else to a swap
+   slot.  An unchanged page is simply dropped, since it can be
+   read from its file or zeroed again.
+   Afterward the page does not own F anymore, but F's PAGE
+   member still points to it until the caller reassigns F.
 
-  /* Remove a victim FTE from the table.
-     It will be pushed back to the table at the end of
-     this procedure. */
-  list_remove (&f->list_elem);
+   TABLE_LOCK is released while the contents are written out,
+   with only F's lock held, so that other page faults need not
+   wait for the disk.  F is out of the frame table by then, so
+   nobody else can choose it, and its page cannot be loaded
+   again until its FRAME member is cleared at the end.
+
+   A shared frame is unmapped from all of its pages.  Its
+   contents are saved once, if at all: a frame shared
+   copy-on-write gives all of its pages the same swap slot. */
+static void
+frame_evict (struct frame *f)
+{
+  struct page *src = f->page;
+  size_t slot = BITMAP_ERROR;
+  struct list_elem *e;
+  bool dirty = false;
 
-  /* Check if the contents of the page to which the victim FTE
-     was allocated has been changed.  Then, remove the
-     corresponding virtual mapping.
+  ASSERT (src != NULL);
+  ASSERT (src->frame == f);
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (lock_held_by_current_thread (&table_lock));
+
+  /* Treat a frame that is not shared as shared by SRC alone. */
+  if (list_empty (&f->sharers))
+    list_push_back (&f->sharers, &src->share_elem);
+  else if (f->inode != NULL)
+    {
+      share_map_cnt -= list_size (&f->sharers);
+      hash_delete (&share_table, &f->share_elem);
+      f->inode = NULL;
+    }
+
+  /* Check if the contents of the pages to which the victim FTE
+     was allocated have been changed.  Then, remove the
+     corresponding virtual mappings.
      
      If the contents has been changed at least once, it should
      be backed up to swap slot whenever future eviction occurs. */
-  pagedir_clear_page (src->owner->pagedir, src->upage);
-  src->dirty |= pagedir_is_dirty (src->owner->pagedir, src->upage);
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    {
+      struct page *s = list_entry (e, struct page, share_elem);
+      pagedir_clear_page (s->owner->pagedir, s->upage);
+      s->dirty |= pagedir_is_dirty (s->owner->pagedir, s->upage);
+      dirty |= s->dirty;
+    }
 
-  if (src->dirty)
+  if (!dirty)
+    drop_cnt++;
+  else
     {
+      bool written = false;
+
+      lock_release (&table_lock);
+
+      /* Write the contents back to the mapped file, from which
+         they will be loaded again.  This fails if the file is
+         an executable that is running, in which case the page
+         goes to swap instead. */
+      if (src->type == PG_MMAP)
+        written = (file_write_at (src->file, f->kpage, src->read_bytes,
+                                  src->file_ofs)
+                   == (off_t) src->read_bytes);
+
       /* Save the previous contents to the swap slot and
          re-initializes supplemental information for later
          page fault handling. */
-      src->slot = swap_out (f->kpage);
-      src->type = PG_SWAP;
-    }
-  
-  /* Transfer the victim frame (doubly linked). */
-  f->page = dst;
-  f->page->frame = f;
+      if (!written)
+        slot = swap_out (f->kpage);
 
-  /* Remove the frame from SRC. */
-  src->frame = NULL;
+      lock_acquire (&table_lock);
 
-  list_push_back (&frame_list, &f->list_elem);
+      if (written)
+        {
+          src->dirty = false;
+          file_out_cnt++;
+        }
+      else
+        {
+          for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+               e = list_next (e))
+            {
+              struct page *s = list_entry (e, struct page, share_elem);
+              if (s != src)
+                swap_dup (slot);
+              s->slot = slot;
+              s->type = PG_SWAP;
+              s->dirty = true;
+            }
+          swap_out_cnt++;
+        }
+    }
+
+  /* Remove the frame from its pages. */
+  while (!list_empty (&f->sharers))
+    list_entry (list_pop_front (&f->sharers),
+                struct page, share_elem)->frame = NULL;
+  cond_broadcast (&evict_cond, &table_lock);
 }
 
 /* Removes a frame table entry F from the table and frees it.
@@ -184,10 +769,16 @@ frame_free (struct frame *f)
   ASSERT (f != NULL);
   ASSERT (lock_held_by_current_thread (&f->lock));
 
+  ASSERT (list_empty (&f->sharers));
+
   lock_acquire (&table_lock);
-  list_remove (&f->list_elem);
-  free (f);
+  frame_table_remove (f);
+  held_cnt--;
   lock_release (&table_lock);
+
+  /* Hand F back in its constructed state. */
+  frame_lock_release (f);
+  kmem_cache_free (frame_cache, f);
 }
 
 /* Acquires FTE F's LOCK, waiting until it becomes available
@@ -219,10 +810,7 @@ bool
 frame_lock_try_acquire (struct frame *f)
 {
   ASSERT (f != NULL);
-  if (f->page->owner == thread_current ())
-    {
-      if (lock_held_by_current_thread (&f->lock))
-        return false;
-    }
+  if (lock_held_by_current_thread (&f->lock))
+    return false;
   return lock_try_acquire (&f->lock);
 }
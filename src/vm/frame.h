@@ -1,8 +1,10 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
+#include <hash.h>
 #include <list.h>
 #include <stdbool.h>
+#include "filesys/off_t.h"
 #include "threads/synch.h"
 
 /* A frame table entry (FTE) which holds a kernel virtual address
@@ -38,12 +40,46 @@ struct frame
     struct lock lock;
 
     struct list_elem list_elem;
+
+    /* A frame may be mapped to several SPTEs at once, which are
+       listed in SHARERS, PAGE being one of them.  SHARERS is
+       empty for a frame mapped to PAGE alone.
+
+       A frame holding a read-only page of a file may be mapped
+       by every process that maps the same page of the same file,
+       so that processes running the same program share its
+       code.  Such a shared frame has a non-null INODE, which
+       together with OFS identifies the page.
+
+       A frame holding a writable page when its process forks is
+       instead shared copy-on-write by the parent and the child,
+       both mapping it read-only until one of them writes to it.
+       Its INODE is null.
+
+       These members, and the FRAME members of the SPTEs in
+       SHARERS, are protected by the frame table's lock rather
+       than by LOCK. */
+    struct inode *inode;
+    off_t ofs;
+    struct list sharers;
+    struct hash_elem share_elem;
   };
 
+extern bool pageout_enabled;
+
 void frame_init (void);
 struct frame *frame_alloc (struct page *);
+struct frame *frame_alloc_zero (struct page *);
+struct frame *frame_alloc_free (struct page *);
 void frame_free (struct frame *);
 
+bool frame_map_shared (struct page *);
+void frame_make_shared (struct frame *);
+bool frame_unshare (struct frame *, struct page *);
+bool frame_share_cow (struct frame *, struct page *, struct page *);
+void frame_break_cow (struct frame *, struct page *);
+void frame_print_stats (void);
+
 void frame_lock_acquire (struct frame *);
 void frame_lock_release (struct frame *);
 bool frame_lock_try_acquire (struct frame *);
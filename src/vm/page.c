@@ -2,11 +2,15 @@
 #include "vm/frame.h"
 #include "vm/swap.h"
 #include <debug.h>
+#include <stdio.h>
 #include <string.h>
 #include <hash.h>
+#include "devices/timer.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/palloc.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
 
@@ -16,6 +20,54 @@ static void page_hash_free (struct hash_elem *, void *);
 
 static void wait_and_destruct_frame (struct page *);
 
+/* If true (default), fork() shares the frames of writable pages
+   between parent and child until either writes to them;
+   otherwise it copies them right away.  Set false by the kernel
+   command-line option -fork-copy. */
+bool fork_cow = true;
+
+/* Number of pages that a page fault reading a page from swap
+   also reads ahead, at most SWAP_READ_MAX - 1.  Set by the
+   kernel command-line option -swap-ra. */
+size_t swap_readahead = SWAP_READ_MAX - 1;
+
+/* A page of zeros, mapped read-only in place of PG_ZERO pages
+   until they are written to. */
+static void *zero_page;
+
+/* Supplemental page table entries. */
+static struct kmem_cache *page_cache;
+
+/* Zero page statistics. */
+static unsigned long long zero_map_cnt;      /* Pages mapped to it. */
+static unsigned long long zero_unmap_cnt;    /* ...then given a frame. */
+
+/* Readahead statistics. */
+static unsigned long long readahead_cnt;     /* Pages read ahead. */
+static unsigned long long readahead_hit_cnt; /* ...and then accessed. */
+
+static void load_swap (struct page *, struct frame *);
+static bool install_page (void *upage, void *kpage, bool writable);
+
+/* Histogram of page_load() latencies in CPU cycles.  A latency
+   whose most significant bit is bit B, for B >= 2, is counted in
+   bucket B * 4 plus the two bits below bit B, so each bucket
+   spans at most a quarter of its lower bound.  Latencies below 4
+   are counted in the bucket of the same number. */
+#define LATENCY_BUCKET_CNT (64 * 4)
+static unsigned long long latency_hist[LATENCY_BUCKET_CNT];
+static unsigned long long load_cnt;
+
+static void account_latency (uint64_t);
+
+/* Initializes the page loader. */
+void
+page_init (void)
+{
+  page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
 /* Creates and initializes a supplemental page table (SPT).
    This table stores SPTEs using their UPAGE as a key. */
 struct hash *
@@ -43,6 +95,115 @@ page_destroy_spt (struct hash *spt)
   free (spt);
 }
 
+static bool copy_page (struct page *, struct page *);
+
+/* Fills the current process's empty SPT with a copy of the SPT
+   of PARENT, which must be blocked until this returns.  Pages
+   that PARENT has not loaded are copied to be loaded the same
+   way, sharing swap slots.  Loaded writable pages are shared
+   copy-on-write, or copied right away if FORK_COW is false, and
+   loaded read-only pages are left to be loaded again, which
+   usually maps them to the same shared frame.
+   PARENT's memory-mapped files are not inherited.
+   Returns true if successful, false if memory allocation
+   failed. */
+bool
+page_copy_spt (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct hash_iterator i;
+
+  ASSERT (hash_empty (cur->spt));
+
+  hash_first (&i, parent->spt);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *c;
+
+      /* Pages of the executable refer to PARENT's copy of it,
+         and any other file is memory-mapped. */
+      if (p->type == PG_MMAP || (p->file != NULL && p->file != parent->bin))
+        continue;
+
+      c = page_make_entry (p->upage);
+      c->writable = p->writable;
+      c->file = p->file != NULL ? cur->bin : NULL;
+      c->file_ofs = p->file_ofs;
+      c->read_bytes = p->read_bytes;
+      c->zero_bytes = p->zero_bytes;
+      if (!copy_page (p, c))
+        return false;
+    }
+  return true;
+}
+
+/* Makes C, a new page of the current process, a copy of PARENT's
+   page P.  Returns true if successful, false if memory allocation
+   failed. */
+static bool
+copy_page (struct page *p, struct page *c)
+{
+  struct frame *f;
+
+  /* P may be being evicted, so retry until the frame we hold is
+     still P's.  P cannot be loaded meanwhile, because only its
+     blocked owner loads it. */
+  for (;;)
+    {
+      if ((f = p->frame) == NULL)
+        {
+          c->type = p->type;
+          c->dirty = p->dirty;
+          if (p->type == PG_SWAP)
+            {
+              swap_dup (p->slot);
+              c->slot = p->slot;
+            }
+          return true;
+        }
+
+      frame_lock_acquire (f);
+      if (p->frame == f)
+        break;
+      frame_lock_release (f);
+    }
+
+  c->type = p->type;
+  if (!p->writable)
+    {
+      /* Same as P before it was loaded. */
+      frame_lock_release (f);
+      return true;
+    }
+
+  if (fork_cow)
+    {
+      bool success = frame_share_cow (f, p, c);
+      frame_lock_release (f);
+      return success;
+    }
+  else
+    {
+      /* Copy everything: a private frame with the same
+         contents, saved to swap if it is ever evicted. */
+      struct frame *copy = frame_alloc (c);
+      bool success;
+
+      memcpy (copy->kpage, f->kpage, PGSIZE);
+      frame_lock_release (f);
+      c->type = PG_SWAP;
+      c->dirty = true;
+      success = pagedir_set_page (c->owner->pagedir, c->upage,
+                                  copy->kpage, true);
+      if (success)
+        frame_lock_release (copy);
+      else
+        frame_free (copy);
+      return success;
+    }
+}
+
 static unsigned
 page_hash_func (const struct hash_elem *e, void *aux UNUSED)
 {
@@ -65,12 +226,16 @@ page_hash_free (struct hash_elem *e, void *aux UNUSED)
 {
   struct page *p = hash_entry (e, struct page, hash_elem);
 
+  if (p->readahead && p->frame != NULL
+      && pagedir_is_accessed (p->owner->pagedir, p->upage))
+    readahead_hit_cnt++;
+
   wait_and_destruct_frame (p);
 
   if (p->slot != BITMAP_ERROR)
     swap_free (p->slot);
 
-  free (p);
+  kmem_cache_free (page_cache, p);
 }
 
 /* Waits until P's frame eviction completes, if being processed,
@@ -86,7 +251,7 @@ page_hash_free (struct hash_elem *e, void *aux UNUSED)
    itself, without waiting:
 
    Suppose that a frame is evicted from SPTE SRC of process P1 to
-   DST of P2.  See frame_do_eviction().  To deprive SRC of its
+   DST of P2.  See frame_evict().  To deprive SRC of its
    FTE and physical frame, P2 should reference SRC and SRC's FRAME
    member.  However, after context switch, if P1 removes and frees
    SRC and allocated frame which is being evicted, whether by exit
@@ -97,6 +262,14 @@ wait_and_destruct_frame (struct page *p)
 {
   struct frame *f = p->frame;
 
+  /* Keep the zero page from being freed along with P's page
+     directory. */
+  if (p->zero_mapped)
+    {
+      pagedir_clear_page (p->owner->pagedir, p->upage);
+      p->zero_mapped = false;
+    }
+
   /* P owns F. */
   if (f != NULL)
     {
@@ -113,6 +286,12 @@ wait_and_destruct_frame (struct page *p)
              own F anymore, thus release lock. */
           frame_lock_release (f);
         }
+      else if (frame_unshare (f, p))
+        {
+          /* Other processes still use F.  P has been detached
+             from it. */
+          frame_lock_release (f);
+        }
       else
         {
           /* F was not a victim; P owns F with being locked.
@@ -141,7 +320,7 @@ page_make_entry (void *upage)
   if (page_lookup (upage))
     return NULL;
   
-  p = malloc (sizeof (struct page));
+  p = kmem_cache_alloc (page_cache);
   if (!p)
     PANIC ("cannot create supplemental page table entry.");
   
@@ -156,6 +335,8 @@ page_make_entry (void *upage)
   p->slot = BITMAP_ERROR;
 
   p->dirty = false;
+  p->readahead = false;
+  p->zero_mapped = false;
 
   hash_insert (cur->spt, &p->hash_elem);
   return p;
@@ -179,11 +360,9 @@ page_remove_entry (struct page *p)
     swap_free (p->slot);
 
   hash_delete (p->owner->spt, &p->hash_elem);
-  free (p);
+  kmem_cache_free (page_cache, p);
 }
 
-static bool install_page (void *upage, void *kpage, bool writable);
-
 /* Loads a user virtual page at UPAGE.
 
    If the current process's SPT does not contain any SPTE
@@ -193,21 +372,47 @@ static bool install_page (void *upage, void *kpage, bool writable);
    Otherwise, it allocates a frame for the SPTE and loads the
    contents of the page from file or swap slot, or fills with
    zeros.  Finally, a user virtual mapping is added to the
-   current process. */
+   current process.  A read-only file page that is already in
+   memory for another process is instead mapped to the same
+   frame.  A page loaded from swap brings along the pages after
+   it that were swapped out next to it, as long as free frames
+   are available for them. */
 bool
 page_load (void *upage)
 {
   ASSERT (is_user_vaddr (upage));
   ASSERT (pg_ofs (upage) == 0);
 
+  uint64_t start = timer_read_tsc ();
   struct page *p = page_lookup (upage);
   if (!p)
     return false;
+  p->readahead = false;
 
-  struct frame *f = frame_alloc (p);
+  /* A page of zeros that was only read so far is being written
+     to, or needs a frame of its own to be pinned. */
+  if (p->zero_mapped)
+    {
+      pagedir_clear_page (p->owner->pagedir, upage);
+      p->zero_mapped = false;
+      zero_unmap_cnt++;
+    }
+
+  /* Read-only pages of a file, such as program code, may
+     already be in memory for another process. */
+  bool shareable = p->type == PG_FILE && !p->writable;
+  if (shareable && frame_map_shared (p))
+    {
+      account_latency (timer_read_tsc () - start);
+      return true;
+    }
+
+  struct frame *f = p->type == PG_ZERO ? frame_alloc_zero (p)
+                                        : frame_alloc (p);
   switch (p->type)
     {
     case PG_FILE:
+    case PG_MMAP:
       {
         size_t read_bytes
           = file_read_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
@@ -218,12 +423,11 @@ page_load (void *upage)
       }
     
     case PG_SWAP:
-      swap_in (f->kpage, p->slot);
-      p->slot = BITMAP_ERROR;
+      load_swap (p, f);
       break;
     
     case PG_ZERO:
-      memset (f->kpage, 0, PGSIZE);
+      /* Already zeroed by frame_alloc_zero(). */
       break;
 
     case PG_UNKNOWN:
@@ -236,7 +440,10 @@ page_load (void *upage)
   if (!install_page (upage, f->kpage, p->writable)) 
     goto fail;
 
+  if (shareable)
+    frame_make_shared (f);
   frame_lock_release (f);
+  account_latency (timer_read_tsc () - start);
   return true;
 
  fail:
@@ -244,6 +451,176 @@ page_load (void *upage)
   return false;
 }
 
+/* Handles a write to user virtual page UPAGE, which is mapped
+   read-only.  Returns true if UPAGE is writable and shared
+   copy-on-write, in which case the current process now has a
+   writable copy of it, or false if the write is invalid. */
+bool
+page_write_fault (void *upage)
+{
+  struct page *p = page_lookup (upage);
+  struct frame *f;
+
+  if (p == NULL || !p->writable)
+    return false;
+
+  /* The frame may be evicted before we lock it, in which case
+     loading it again gives P a private frame. */
+  for (;;)
+    {
+      if ((f = p->frame) == NULL)
+        return page_load (upage);
+
+      frame_lock_acquire (f);
+      if (p->frame == f)
+        break;
+      frame_lock_release (f);
+    }
+
+  frame_break_cow (f, p);
+  frame_lock_release (f);
+  return true;
+}
+
+/* Handles a read from user virtual page UPAGE, which is not
+   present.  If UPAGE is a PG_ZERO page, maps it read-only to the
+   shared zero page, so that it takes no frame until it is
+   written to, and returns true.  Otherwise, returns false, and
+   the page must be loaded with page_load(). */
+bool
+page_map_zero (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  if (p == NULL || p->type != PG_ZERO || p->frame != NULL)
+    return false;
+
+  ASSERT (!p->zero_mapped);
+  if (!pagedir_set_page (p->owner->pagedir, upage, zero_page, false))
+    return false;
+  p->zero_mapped = true;
+  zero_map_cnt++;
+  return true;
+}
+
+/* Reads P, which is in swap, into P's frame F, along with up to
+   SWAP_READAHEAD of the pages that follow P in the current
+   process's address space, as long as each is in the swap slot
+   after the previous one and a free frame is available for it.
+   Those pages are mapped right away. */
+static void
+load_swap (struct page *p, struct frame *f)
+{
+  void *kpages[SWAP_READ_MAX];
+  struct frame *ra_frames[SWAP_READ_MAX];
+  size_t cnt, i;
+
+  ASSERT (swap_readahead < SWAP_READ_MAX);
+
+  kpages[0] = f->kpage;
+  for (cnt = 1; cnt <= swap_readahead; cnt++)
+    {
+      void *upage = p->upage + cnt * PGSIZE;
+      struct page *q;
+      struct frame *qf;
+
+      if (!is_user_vaddr (upage))
+        break;
+      q = page_lookup (upage);
+      if (q == NULL || q->frame != NULL || q->type != PG_SWAP
+          || q->slot != p->slot + cnt)
+        break;
+      if ((qf = frame_alloc_free (q)) == NULL)
+        break;
+
+      /* Map Q before reading it, so that nothing is lost if the
+         mapping cannot be made.  Nobody else can look at Q until
+         we return. */
+      if (!install_page (upage, qf->kpage, q->writable))
+        {
+          q->frame = NULL;
+          palloc_free_page (qf->kpage);
+          frame_free (qf);
+          break;
+        }
+      kpages[cnt] = qf->kpage;
+      ra_frames[cnt] = qf;
+    }
+
+  swap_in_cluster (kpages, p->slot, cnt);
+  p->slot = BITMAP_ERROR;
+
+  for (i = 1; i < cnt; i++)
+    {
+      struct page *q = ra_frames[i]->page;
+      q->slot = BITMAP_ERROR;
+      q->readahead = true;
+      frame_lock_release (ra_frames[i]);
+    }
+  readahead_cnt += cnt - 1;
+}
+
+/* Records a page_load() that took CYCLES. */
+static void
+account_latency (uint64_t cycles)
+{
+  int msb, bucket;
+
+  for (msb = 63; msb > 0 && !(cycles >> msb); msb--)
+    continue;
+  if (msb < 2)
+    bucket = cycles;
+  else
+    bucket = msb * 4 + ((cycles >> (msb - 2)) & 3);
+  latency_hist[bucket]++;
+  load_cnt++;
+}
+
+/* Returns the lower bound of the latencies in histogram
+   BUCKET. */
+static uint64_t
+bucket_latency (int bucket)
+{
+  int msb = bucket / 4;
+  if (msb < 2)
+    return bucket;
+  else
+    return (uint64_t) (4 + bucket % 4) << (msb - 2);
+}
+
+/* Returns the latency, in cycles, that PERCENT percent of page
+   loads took at most, to the precision of the histogram. */
+static uint64_t
+latency_percentile (int percent)
+{
+  unsigned long long rank = (load_cnt * percent + 99) / 100;
+  unsigned long long seen = 0;
+  int i;
+
+  for (i = 0; i < LATENCY_BUCKET_CNT; i++)
+    {
+      seen += latency_hist[i];
+      if (seen >= rank && seen > 0)
+        return bucket_latency (i);
+    }
+  return 0;
+}
+
+/* Prints the number of pages loaded and percentiles of the time
+   that page faults took to load them. */
+void
+page_print_stats (void)
+{
+  printf ("Page loads: %llu, latency p50 %"PRIu64", p90 %"PRIu64
+          ", p99 %"PRIu64" cycles\n", load_cnt, latency_percentile (50),
+          latency_percentile (90), latency_percentile (99));
+  printf ("Zero page: %llu pages mapped to it, %llu of them written "
+          "later\n", zero_map_cnt, zero_unmap_cnt);
+  printf ("Swap readahead: %llu pages read ahead, %llu used (%llu%%)\n",
+          readahead_cnt, readahead_hit_cnt,
+          readahead_cnt > 0 ? readahead_hit_cnt * 100 / readahead_cnt : 0);
+}
+
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -299,5 +676,11 @@ page_was_accessed (struct page *p)
   bool accessed = pagedir_is_accessed (pd, upage);
   pagedir_set_accessed (pd, upage, false);
 
+  if (accessed && p->readahead)
+    {
+      p->readahead = false;
+      readahead_hit_cnt++;
+    }
+
   return accessed;
 }
\ No newline at end of file
@@ -13,7 +13,8 @@ enum page_type
     PG_FILE = 1,                        /* Load from file. */
     PG_SWAP = 2,                        /* Load from swap slot. */
     PG_ZERO = 3,                        /* Zero page contents. */
-    PG_UNKNOWN = 4                      /* Unknown (for debugging purposes). */
+    PG_MMAP = 4,                        /* Load from and save to file. */
+    PG_UNKNOWN = 5                      /* Unknown (for debugging purposes). */
   };
 
 /* A supplemental page table entry (SPTE) which provides
@@ -63,14 +64,15 @@ struct page
        Notice that the contents reside in the corresponding physical
        frame, and this frame could be evicted.  When a physical frame
        is evicted and the owner of the frame changes from this SPTE
-       to another one, its contents must be backed up in the swap slot,
-       if DIRTY is true. */
+       to another one, its contents must be backed up if DIRTY is
+       true: written back to the file for a PG_MMAP page, after
+       which DIRTY is false again, and to a swap slot otherwise. */
     bool dirty;
 
     /* How to load this page? */
     enum page_type type;
 
-    /* Used if TYPE is PG_FILE. */
+    /* Used if TYPE is PG_FILE or PG_MMAP. */
     struct file *file;                  /* File. */
     off_t file_ofs;                     /* Offset. */
     size_t read_bytes;                  /* File read amount. */
@@ -79,18 +81,38 @@ struct page
     /* Used if TYPE is PG_SWAP. */
     size_t slot;                        /* Index of swap slot. */
 
+    /* True if the page was loaded by readahead rather than on
+       demand, and has not been found accessed since. */
+    bool readahead;
+
+    /* True if the page is a PG_ZERO page that has only been read
+       so far, and so is mapped read-only to the shared zero page
+       instead of to a frame of its own.  FRAME is null. */
+    bool zero_mapped;
+
     struct hash_elem hash_elem;         /* Hash element. */
+    struct list_elem share_elem;        /* Element in frame's SHARERS. */
   };
 
+extern bool fork_cow;
+extern size_t swap_readahead;
+
+void page_init (void);
+
 struct hash *page_create_spt (void);
 void page_destroy_spt (struct hash *);
+bool page_copy_spt (struct thread *);
 
 struct page *page_make_entry (void *);
 void page_remove_entry (struct page *);
 
 bool page_load (void *);
+bool page_map_zero (void *);
+bool page_write_fault (void *);
 struct page *page_lookup (void *);
 
 bool page_was_accessed (struct page *);
 
+void page_print_stats (void);
+
 #endif /* vm/page.h */
\ No newline at end of file
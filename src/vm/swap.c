@@ -1,9 +1,13 @@
 #include "vm/swap.h"
 #include <debug.h>
 #include <bitmap.h>
+#include <limits.h>
+#include <stdio.h>
 #include "devices/block.h"
+#include "threads/malloc.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
+#include "vm/zswap.h"
 
 /* Number of sectors per page. */
 #define PAGE_SECTOR_CNT (PGSIZE / BLOCK_SECTOR_SIZE)
@@ -20,6 +24,30 @@ static struct bitmap *used_map;
 /* Number of swap slots. */
 static size_t swap_slots;
 
+/* Number of references to each used slot beyond the first.
+   A slot is shared by the pages of forked processes that held
+   the same page when it was evicted; it is freed when the last
+   of them is loaded or destroyed. */
+static unsigned short *extra_refs;
+
+/* Slots are allocated in order from clusters of SWAP_CLUSTER
+   free slots, so that pages evicted one after another, such as
+   a batch evicted by the pageout daemon, land in adjacent slots
+   and can be read back together.  CLUSTER_NEXT is the next slot
+   to allocate and CLUSTER_LEFT the number of slots left in the
+   current cluster. */
+#define SWAP_CLUSTER 16
+static size_t cluster_next;
+static size_t cluster_left;
+
+/* Statistics. */
+static unsigned long long out_cnt;          /* Pages written. */
+static unsigned long long cluster_out_cnt;  /* ...to slots in clusters. */
+static unsigned long long in_cnt;           /* Pages read. */
+static unsigned long long in_request_cnt;   /* swap_in_cluster() calls. */
+
+static size_t alloc_slot (void);
+
 /* Initializes the swap slot allocator.  At most SWAP_SLOTS
    slots are available. */
 void
@@ -33,67 +61,166 @@ swap_init (void)
 
   if (!used_map)
     PANIC ("bitmap allocation failed.");
+
+  extra_refs = calloc (swap_slots, sizeof *extra_refs);
+  if (extra_refs == NULL && swap_slots > 0)
+    PANIC ("cannot allocate swap slot reference counts.");
+
+  zswap_init (swap_slots);
   
   lock_init (&swap_lock);
 }
 
 /* Writes PGSIZE bytes to a free slot from KPAGE.  Returns the
-   index of the free slot. 
+   index of the free slot.  The compressed swap cache keeps the
+   page instead, if it can.
    If too few slots are available, kernel panics. */
 size_t
 swap_out (void* kpage)
 {
   size_t slot;
-  block_sector_t sector;
-  int i;
 
   ASSERT (kpage != NULL);
 
   lock_acquire (&swap_lock);
-  slot = bitmap_scan_and_flip (used_map, 0, 1, false);
+  slot = alloc_slot ();
   lock_release (&swap_lock);
 
   if (slot != BITMAP_ERROR)
     {
-      sector = slot * PAGE_SECTOR_CNT;
-      for (i = 0; i < PAGE_SECTOR_CNT; i++)
-        {
-          block_write (swap_bdev, sector + i,
-                       kpage + BLOCK_SECTOR_SIZE * i);
-        }
+      if (zswap_store (slot, kpage))
+        return slot;
+      block_write_multiple (swap_bdev, slot * PAGE_SECTOR_CNT,
+                            PAGE_SECTOR_CNT, kpage);
       return slot;
     }
   else
     PANIC ("cannot find any free swap slot.");
 }
 
-/* Reads PGSIZE bytes from SLOT into KPAGE and frees SLOT. */
+/* Allocates a swap slot and returns its index, or BITMAP_ERROR
+   if all slots are in use.  The next slot of the current cluster
+   is preferred; if there is none, a new cluster is started, or,
+   if no SWAP_CLUSTER free slots are adjacent, any free slot is
+   used. */
+static size_t
+alloc_slot (void)
+{
+  size_t slot;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  if (cluster_left == 0)
+    {
+      cluster_next = bitmap_scan (used_map, 0, SWAP_CLUSTER, false);
+      if (cluster_next != BITMAP_ERROR)
+        cluster_left = SWAP_CLUSTER;
+    }
+
+  out_cnt++;
+  if (cluster_left > 0)
+    {
+      /* Only this function marks slots used, so the rest of the
+         cluster is still free. */
+      slot = cluster_next++;
+      cluster_left--;
+      bitmap_mark (used_map, slot);
+      cluster_out_cnt++;
+      return slot;
+    }
+  return bitmap_scan_and_flip_next (used_map, 1, false);
+}
+
+/* Reads PGSIZE bytes from SLOT into KPAGE and drops a
+   reference to SLOT. */
 void
 swap_in (void *kpage, size_t slot)
 {
-  block_sector_t sector;
-  int i;
-
   ASSERT (kpage != NULL);
   ASSERT (slot != BITMAP_ERROR);
 
-  sector = slot * PAGE_SECTOR_CNT;
-  for (i = 0; i < PAGE_SECTOR_CNT; i++)
+  swap_in_cluster (&kpage, slot, 1);
+}
+
+/* Reads the CNT adjacent slots starting at SLOT into the pages
+   KPAGES[0] through KPAGES[CNT - 1] and drops a reference to
+   each of them.  The reads are all queued at once, so the disk
+   can carry them out in one sweep.  CNT must not exceed
+   SWAP_READ_MAX. */
+void
+swap_in_cluster (void **kpages, size_t slot, size_t cnt)
+{
+  struct block_request reqs[SWAP_READ_MAX];
+  bool on_disk[SWAP_READ_MAX];
+  size_t i;
+
+  ASSERT (cnt > 0 && cnt <= SWAP_READ_MAX);
+  ASSERT (slot != BITMAP_ERROR && slot + cnt <= swap_slots);
+
+  for (i = 0; i < cnt; i++)
+    {
+      ASSERT (kpages[i] != NULL);
+      on_disk[i] = !zswap_load (slot + i, kpages[i]);
+      if (on_disk[i])
+        {
+          block_request_init (&reqs[i], (slot + i) * PAGE_SECTOR_CNT,
+                              PAGE_SECTOR_CNT, kpages[i], false,
+                              NULL, NULL);
+          block_submit (swap_bdev, &reqs[i]);
+        }
+    }
+  for (i = 0; i < cnt; i++)
     {
-      block_read (swap_bdev, sector + i,
-                  kpage + BLOCK_SECTOR_SIZE * i);
+      if (on_disk[i])
+        block_wait (&reqs[i]);
+      swap_free (slot + i);
     }
 
-  ASSERT (bitmap_all (used_map, slot, 1));
-  bitmap_set_multiple (used_map, slot, 1, false);
+  lock_acquire (&swap_lock);
+  in_cnt += cnt;
+  in_request_cnt++;
+  lock_release (&swap_lock);
 }
 
-/* Just frees SLOT. */
+/* Drops a reference to SLOT, freeing it if that was the last
+   one. */
 void
 swap_free (size_t slot)
 {
   ASSERT (slot != BITMAP_ERROR);
+
+  lock_acquire (&swap_lock);
   ASSERT (bitmap_all (used_map, slot, 1));
-  
-  bitmap_set_multiple (used_map, slot, 1, false);
-}
\ No newline at end of file
+  if (extra_refs[slot] > 0)
+    extra_refs[slot]--;
+  else
+    {
+      bitmap_set_multiple (used_map, slot, 1, false);
+      zswap_drop (slot);
+    }
+  lock_release (&swap_lock);
+}
+
+/* Adds a reference to used SLOT, which must then be freed once
+   more before it is reused. */
+void
+swap_dup (size_t slot)
+{
+  ASSERT (slot != BITMAP_ERROR);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_all (used_map, slot, 1));
+  ASSERT (extra_refs[slot] < USHRT_MAX);
+  extra_refs[slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Prints swap slot allocation and read statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %llu pages written, %llu to clustered slots; "
+          "%llu pages read in %llu batches\n",
+          out_cnt, cluster_out_cnt, in_cnt, in_request_cnt);
+  zswap_print_stats ();
+}
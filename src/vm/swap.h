@@ -4,9 +4,15 @@
 #include <stddef.h>
 #include <bitmap.h>
 
+/* Maximum number of slots read by one swap_in_cluster(). */
+#define SWAP_READ_MAX 9
+
 void swap_init (void);
 size_t swap_out (void *);
 void swap_in (void *, size_t);
+void swap_in_cluster (void **, size_t slot, size_t cnt);
 void swap_free (size_t);
+void swap_dup (size_t);
+void swap_print_stats (void);
 
 #endif /* vm/swap.h */
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "vm/zswap.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Compressed swap cache.
+
+   Pages written to swap are first offered to this cache, which
+   keeps them in kernel memory, compressed, under the swap slot
+   allocated for them.  A page whose 32-bit words are all the
+   same, such as a page of zeros, takes no more than its entry.
+   Any other page is compressed with a simple LZ77 coder and kept
+   if its entry fits in malloc()'s largest block size, so that it
+   does not take a page of its own.  Pages that do not compress
+   well, or that do not fit in the cache's memory budget, go to
+   the swap device as usual.  Entries are charged against the
+   budget at the size of the block that malloc() gives them. */
+
+/* Kernel pages' worth of memory that the cache may use.  Zero,
+   the default, disables the cache.  Set by the kernel
+   command-line option -zswap. */
+size_t zswap_limit;
+
+/* A page kept in the cache. */
+struct zentry
+  {
+    size_t len;                 /* Compressed length, 0 if same-filled. */
+    uint32_t fill;              /* Word repeated if LEN is 0. */
+    uint8_t data[];             /* LEN bytes of compressed data. */
+  };
+
+/* Largest entry kept, header included: malloc()'s largest block
+   size.  Bigger requests would each take a whole page. */
+#define ZSWAP_MAX_ENTRY 1024
+
+/* Largest compressed page kept. */
+#define ZSWAP_MAX_LEN (ZSWAP_MAX_ENTRY - sizeof (struct zentry))
+
+/* Mutual exclusion. */
+static struct lock zswap_lock;
+
+/* Entry for each swap slot, or a null pointer for slots whose
+   contents are on the swap device. */
+static struct zentry **entries;
+
+/* Bytes of memory used by entries. */
+static size_t used_bytes;
+
+/* Output buffer for compression. */
+static uint8_t zbuf[ZSWAP_MAX_LEN];
+
+/* Statistics. */
+static unsigned long long store_cnt;        /* Pages stored. */
+static unsigned long long same_cnt;         /* ...that were same-filled. */
+static unsigned long long spill_cnt;        /* Pages left to the disk. */
+static unsigned long long load_cnt;         /* Pages loaded. */
+static unsigned long long stored_bytes;     /* Bytes charged for entries. */
+
+static size_t entry_size (size_t len);
+static bool same_filled (const void *, uint32_t *fill);
+static size_t lz_compress (const uint8_t *, uint8_t *, size_t);
+static void lz_decompress (const uint8_t *, size_t, uint8_t *);
+
+/* Initializes the cache for a swap device with SLOT_CNT slots,
+   unless it is disabled. */
+void
+zswap_init (size_t slot_cnt)
+{
+  if (zswap_limit == 0)
+    return;
+
+  lock_init (&zswap_lock);
+  entries = calloc (slot_cnt, sizeof *entries);
+  if (entries == NULL && slot_cnt > 0)
+    PANIC ("cannot allocate compressed swap cache.");
+}
+
+/* Tries to keep the page at KPAGE in the cache as the contents
+   of swap SLOT.  Returns true if successful, false if the page
+   must be written to the swap device instead. */
+bool
+zswap_store (size_t slot, const void *kpage)
+{
+  struct zentry *e = NULL;
+  uint32_t fill = 0;
+  size_t len = 0;
+  bool same;
+
+  if (entries == NULL)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  ASSERT (entries[slot] == NULL);
+  same = same_filled (kpage, &fill);
+  if (!same)
+    len = lz_compress (kpage, zbuf, ZSWAP_MAX_LEN);
+  if ((same || len > 0)
+      && used_bytes + entry_size (len) <= zswap_limit * PGSIZE
+      && (e = malloc (sizeof *e + len)) != NULL)
+    {
+      e->len = len;
+      e->fill = fill;
+      memcpy (e->data, zbuf, len);
+      entries[slot] = e;
+      used_bytes += entry_size (len);
+      stored_bytes += entry_size (len);
+      store_cnt++;
+      if (len == 0)
+        same_cnt++;
+    }
+  else
+    spill_cnt++;
+  lock_release (&zswap_lock);
+
+  return e != NULL;
+}
+
+/* Fills KPAGE with the contents of swap SLOT and returns true if
+   the cache has them, otherwise returns false.  The cache keeps
+   them until zswap_drop(). */
+bool
+zswap_load (size_t slot, void *kpage)
+{
+  struct zentry *e;
+
+  if (entries == NULL)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  e = entries[slot];
+  if (e != NULL)
+    {
+      if (e->len == 0)
+        {
+          uint32_t *word = kpage;
+          size_t i;
+
+          for (i = 0; i < PGSIZE / sizeof *word; i++)
+            word[i] = e->fill;
+        }
+      else
+        lz_decompress (e->data, e->len, kpage);
+      load_cnt++;
+    }
+  lock_release (&zswap_lock);
+
+  return e != NULL;
+}
+
+/* Forgets the cached contents of swap SLOT, which is being
+   freed, if any. */
+void
+zswap_drop (size_t slot)
+{
+  struct zentry *e;
+
+  if (entries == NULL)
+    return;
+
+  lock_acquire (&zswap_lock);
+  e = entries[slot];
+  if (e != NULL)
+    {
+      entries[slot] = NULL;
+      used_bytes -= entry_size (e->len);
+      free (e);
+    }
+  lock_release (&zswap_lock);
+}
+
+/* Prints compressed swap cache statistics. */
+void
+zswap_print_stats (void)
+{
+  if (entries == NULL)
+    return;
+
+  printf ("Zswap: %llu pages stored (%llu same-filled) in %llu bytes, "
+          "%llu%% of their size; %llu pages spilled to disk, "
+          "%llu loaded\n",
+          store_cnt, same_cnt, stored_bytes,
+          store_cnt > 0 ? stored_bytes * 100 / (store_cnt * PGSIZE) : 0,
+          spill_cnt, load_cnt);
+}
+
+/* Returns the bytes that malloc() sets aside for an entry with
+   LEN bytes of compressed data: the entry's size rounded up to a
+   power of 2, at least 16. */
+static size_t
+entry_size (size_t len)
+{
+  size_t size = 16;
+
+  ASSERT (sizeof (struct zentry) + len <= ZSWAP_MAX_ENTRY);
+  while (size < sizeof (struct zentry) + len)
+    size *= 2;
+  return size;
+}
+
+/* Returns true if every 32-bit word of the page at KPAGE is the
+   same, storing that word in *FILL. */
+static bool
+same_filled (const void *kpage, uint32_t *fill)
+{
+  const uint32_t *word = kpage;
+  size_t i;
+
+  for (i = 1; i < PGSIZE / sizeof *word; i++)
+    if (word[i] != word[0])
+      return false;
+  *fill = word[0];
+  return true;
+}
+
+/* The LZ77 coder's format is a sequence of tokens, each of which
+   starts with a control byte C.  If C is less than 0x80, then
+   C + 1 literal bytes follow.  Otherwise, the token is a match of
+   (C & 0x7f) + MIN_MATCH bytes copied from earlier output, at the
+   distance given by the 16-bit little-endian word that follows. */
+#define MIN_MATCH 4
+#define MAX_MATCH (0x7f + MIN_MATCH)
+#define MAX_LITERALS 0x80
+
+/* Hash table of positions (plus 1) of recent 4-byte sequences. */
+#define HASH_BITS 10
+static uint16_t hash_table[1 << HASH_BITS];
+
+/* Reads a 32-bit little-endian word at P. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Appends SRC's CNT literal bytes to the DST_MAX-byte buffer DST,
+   which already holds *OUT bytes.  Returns false if they do not
+   fit. */
+static bool
+emit_literals (const uint8_t *src, size_t cnt, uint8_t *dst, size_t *out,
+               size_t dst_max)
+{
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_LITERALS ? cnt : MAX_LITERALS;
+      if (*out + 1 + n > dst_max)
+        return false;
+      dst[(*out)++] = n - 1;
+      memcpy (dst + *out, src, n);
+      *out += n;
+      src += n;
+      cnt -= n;
+    }
+  return true;
+}
+
+/* Compresses the page at SRC into DST, which has room for
+   DST_MAX bytes.  Returns the compressed length, or 0 if it
+   would exceed DST_MAX. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t dst_max)
+{
+  size_t pos = 0, lit_start = 0, out = 0;
+
+  ASSERT (lock_held_by_current_thread (&zswap_lock));
+
+  memset (hash_table, 0, sizeof hash_table);
+  while (pos + MIN_MATCH <= PGSIZE)
+    {
+      uint32_t seq = read32 (src + pos);
+      unsigned h = (seq * 2654435761u) >> (32 - HASH_BITS);
+      size_t cand = hash_table[h];
+
+      hash_table[h] = pos + 1;
+      if (cand != 0 && read32 (src + cand - 1) == seq)
+        {
+          size_t match = cand - 1;
+          size_t len = MIN_MATCH;
+          size_t dist = pos - match;
+
+          while (pos + len < PGSIZE && len < MAX_MATCH
+                 && src[match + len] == src[pos + len])
+            len++;
+
+          if (!emit_literals (src + lit_start, pos - lit_start,
+                              dst, &out, dst_max)
+              || out + 3 > dst_max)
+            return 0;
+          dst[out++] = 0x80 | (len - MIN_MATCH);
+          dst[out++] = dist & 0xff;
+          dst[out++] = dist >> 8;
+
+          pos += len;
+          lit_start = pos;
+        }
+      else
+        pos++;
+    }
+
+  if (!emit_literals (src + lit_start, PGSIZE - lit_start,
+                      dst, &out, dst_max))
+    return 0;
+  return out;
+}
+
+/* Decompresses the LEN bytes at SRC, produced by lz_compress(),
+   into the page at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst)
+{
+  size_t in = 0, out = 0;
+
+  while (in < len)
+    {
+      uint8_t c = src[in++];
+      if (c & 0x80)
+        {
+          size_t n = (c & 0x7f) + MIN_MATCH;
+          size_t dist = src[in] | (src[in + 1] << 8);
+
+          in += 2;
+          ASSERT (dist > 0 && dist <= out && out + n <= PGSIZE);
+
+          /* The source may overlap the destination. */
+          for (; n > 0; n--, out++)
+            dst[out] = dst[out - dist];
+        }
+      else
+        {
+          size_t n = c + 1;
+
+          ASSERT (in + n <= len && out + n <= PGSIZE);
+          memcpy (dst + out, src + in, n);
+          in += n;
+          out += n;
+        }
+    }
+  ASSERT (out == PGSIZE);
+}